@@ -7,23 +7,26 @@
  * Usage:
  *   node capture-continuous.js
  *
- * KNOWN BUG: The Eufy livestream times out after ~25 seconds. This appears to
- * be a limitation of the eufy-security-client library or the Eufy P2P protocol.
- * The issue has not been resolved. For reliable capture, use capture.js with
- * --loop instead.
+ * The Eufy livestream stops after ~25 seconds (a limitation of the Eufy P2P
+ * protocol). lib/continuous-stream.js restarts it as soon as it stops and
+ * feeds every session into one long-lived ffmpeg decoder, re-syncing on the
+ * next keyframe. Decoded frames are kept in an in-memory ring; restart gap
+ * durations are written to data/metrics-continuous.json every minute.
  */
 
 import "dotenv/config";
 import { EufySecurity, Camera } from "eufy-security-client";
 import fs from "fs";
-import { spawn } from "child_process";
-import path from "path";
 
 import { logger } from "./lib/logger.js";
+import { createMetrics } from "./lib/metrics.js";
+import { createContinuousStream } from "./lib/continuous-stream.js";
 
 const OUTPUT_ROOT = "./captured";
 const SNAPSHOTS_DIR = `${OUTPUT_ROOT}/snapshots`;
 const FRAME_INTERVAL_S = 5;
+const RING_SIZE = 12; // one minute of frames at FRAME_INTERVAL_S
+const METRICS_FLUSH_MS = 60 * 1000;
 const DEVICE_DISCOVERY_TIMEOUT_MS = 5000;
 const TARGET_CAMERA_NAME = "775";
 
@@ -61,63 +64,27 @@ function ensureDirectories() {
   });
 }
 
-let ffmpegProcess = null;
+let stream = null;
 let eufy = null;
 let frameCount = 0;
+const metrics = createMetrics("continuous");
 
-function createFFmpegProcess(codecExt, device) {
+/**
+ * Save each decoded frame from the live ring to disk
+ */
+function createFrameSaver(device) {
   const timestamp = Date.now();
-  const outputPattern = `${SNAPSHOTS_DIR}/frame_${device.getSerial()}_${timestamp}_%06d.jpg`;
-
-  const ffmpegArgs = [
-    "-f", codecExt === "h265" ? "hevc" : "h264",
-    "-i", "pipe:0",
-    "-vf", `fps=1/${FRAME_INTERVAL_S}`,
-    "-q:v", "2",
-    "-update", "0",
-    outputPattern,
-  ];
-
-  const proc = spawn("ffmpeg", ffmpegArgs);
-
-  proc.stderr.on("data", (data) => {
-    const message = data.toString();
-    if (message.includes("frame=")) {
-      const frameMatch = message.match(/frame=\s*(\d+)/);
-      if (frameMatch) {
-        frameCount = parseInt(frameMatch[1]);
-        process.stdout.write(`\rFrames captured: ${frameCount}`);
-      }
-    }
-  });
-
-  proc.on("close", (code) => {
-    logger.info(`FFmpeg exited with code ${code}`);
-  });
-
-  proc.on("error", (err) => {
-    logger.error("FFmpeg error", { error: err.message });
-  });
-
-  logger.info(`Saving frames to: ${outputPattern}`);
-
-  return proc;
-}
-
-async function handleLivestreamStart(station, device, metadata, videoStream, audioStream) {
-  logger.info("Livestream started", { device: device.getName() });
-  logger.debug("Stream metadata", { metadata });
-
-  const codecExt = metadata.videoCodec === 1 ? "h265" : "h264";
-  ffmpegProcess = createFFmpegProcess(codecExt, device);
-
-  videoStream.on("data", (chunk) => {
-    if (ffmpegProcess && !ffmpegProcess.stdin.destroyed) {
-      ffmpegProcess.stdin.write(chunk);
-    }
-  });
-
-  logger.info("Capturing frames continuously. Press Ctrl+C to stop.");
+  const outputPrefix = `${SNAPSHOTS_DIR}/frame_${device.getSerial()}_${timestamp}_`;
+  logger.info(`Saving frames to: ${outputPrefix}%06d.jpg`);
+
+  return (frame) => {
+    frameCount++;
+    const outputPath = `${outputPrefix}${String(frameCount).padStart(6, "0")}.jpg`;
+    fs.writeFile(outputPath, frame.jpeg, (err) => {
+      if (err) logger.error("Failed to save frame", { error: err.message });
+    });
+    process.stdout.write(`\rFrames captured: ${frameCount}`);
+  };
 }
 
 function findTargetCamera(cameras) {
@@ -131,21 +98,15 @@ function findTargetCamera(cameras) {
   );
 }
 
-async function shutdown(targetSerial) {
+async function shutdown() {
   logger.info("Shutting down...");
 
-  if (ffmpegProcess && !ffmpegProcess.stdin.destroyed) {
-    ffmpegProcess.stdin.end();
+  if (stream) {
+    await stream.stop();
+    logger.info("Stopped livestream");
   }
 
-  if (eufy && targetSerial) {
-    try {
-      await eufy.stopStationLivestream(targetSerial);
-      logger.info("Stopped livestream");
-    } catch (e) {
-      // Ignore errors during shutdown
-    }
-  }
+  metrics.flush();
 
   if (eufy) {
     eufy.close();
@@ -162,23 +123,13 @@ async function main() {
   eufy = await EufySecurity.initialize(eufyConfig, consoleLogger);
   logger.info("Logging in to Eufy...");
 
-  let targetSerial = null;
-
   eufy.on("device added", (device) => {
     logger.info(`Device found: ${device.getName()} (${device.getSerial()})`);
   });
 
-  eufy.on("station livestream start", async (station, device, metadata, videoStream, audioStream) => {
-    await handleLivestreamStart(station, device, metadata, videoStream, audioStream);
-  });
-
-  eufy.on("station livestream stop", () => {
-    logger.warn("Livestream stopped unexpectedly");
-  });
-
   // Handle Ctrl+C
-  process.on("SIGINT", () => shutdown(targetSerial));
-  process.on("SIGTERM", () => shutdown(targetSerial));
+  process.on("SIGINT", shutdown);
+  process.on("SIGTERM", shutdown);
 
   await eufy.connect();
   logger.info("Connected successfully!");
@@ -194,11 +145,19 @@ async function main() {
   }
 
   const targetDevice = findTargetCamera(cameras);
-  targetSerial = targetDevice.getSerial();
   logger.info(`Using camera: ${targetDevice.getName()}`);
 
   logger.info("Starting continuous livestream...");
-  await eufy.startStationLivestream(targetSerial);
+  stream = createContinuousStream(eufy, targetDevice, {
+    ringSize: RING_SIZE,
+    sampleIntervalS: FRAME_INTERVAL_S,
+    metrics,
+    onFrame: createFrameSaver(targetDevice),
+  });
+  await stream.start();
+  logger.info("Capturing frames continuously. Press Ctrl+C to stop.");
+
+  setInterval(() => metrics.flush(), METRICS_FLUSH_MS);
 
   // Keep running until Ctrl+C
   await new Promise(() => {});
@@ -1,34 +1,115 @@
 import "dotenv/config";
 import { EufySecurity, Device, Camera } from "eufy-security-client";
 import fs from "fs";
-import { spawn } from "child_process";
 import path from "path";
 
 import { logger } from "./lib/logger.js";
-import { detectPackage } from "./lib/package-detector.js";
-import {
-  createClient,
-  publishPackageStatus,
-  disconnect,
-} from "./lib/mqtt-client.js";
-import { addTextOverlay } from "./lib/image-processor.js";
-import { cleanupOldFiles } from "./lib/utils.js";
+import { createPublisher, publishPackageStatus } from "./lib/mqtt-client.js";
+import { parseDuration } from "./lib/utils.js";
+import { createCaptureScheduler } from "./lib/capture-scheduler.js";
+import { createMetrics } from "./lib/metrics.js";
+import { createPolicy } from "./lib/capture-policy.js";
+import { openVideoRingStore } from "./lib/video-ring-store.js";
+import { createDeviceRegistry } from "./lib/device-registry.js";
+import { createFFmpegPool } from "./lib/ffmpeg-pool.js";
+import { createStationSessions } from "./lib/station-sessions.js";
+import { createTracer } from "./lib/tracing.js";
+import { createDetectionPool } from "./lib/detection-pool.js";
+import { createAnnotationQueue } from "./lib/annotation-queue.js";
+import { createChangeGate } from "./lib/change-gate.js";
+import { createBackgroundModel } from "./lib/background-model.js";
+import { createPhashCache } from "./lib/phash-cache.js";
+import { createSnapshotStore } from "./lib/snapshot-store.js";
+import { createRetentionManager } from "./lib/retention-manager.js";
+import { roiThumbnail, validateRoi } from "./lib/image-processor.js";
+import { QUALITY_WIDTH, scoreFrame } from "./lib/frame-quality.js";
 
 const OUTPUT_ROOT = "./captured";
 const SNAPSHOTS_DIR = `${OUTPUT_ROOT}/snapshots`;
-const VIDEOS_DIR = `${OUTPUT_ROOT}/videos`;
-const COOLDOWN_STATE_FILE = "./data/cooldown-state.json";
-const IMAGE_STATE_FILE = "./data/image-state.json";
+const VIDEO_RING_DIR = `${OUTPUT_ROOT}/video-ring`;
+const SNAPSHOT_STORE_DIR = `${OUTPUT_ROOT}/store`;
+const DATA_DIR = "./data";
+const COOLDOWN_STATE_FILE = `${DATA_DIR}/cooldown-state.json`;
 const CAPTURE_DURATION_MS = 3000;
 const FRAME_CAPTURE_INTERVAL_S = 1;
-const DEVICE_DISCOVERY_TIMEOUT_MS = 5000;
+// "best": detect on the capture's sharpest, best-exposed frame; "latest": its newest
+const FRAME_SELECTION = process.env.FRAME_SELECTION || "best";
+// With "best", an earlier frame is only used when the newest scores below
+// this fraction of the capture's median. The score also rises with scene
+// detail (someone's legs in view), so a small lead is not a better frame.
+const FRAME_SELECTION_MIN_RATIO = 0.5;
+const EUFY_READY_TIMEOUT_MS = 30000;
 const CAPTURE_TIMEOUT_MS = 30000;
 const RUN_ONCE_TIMEOUT_MS = 90000;
 const AUTH_BACKOFF_MS = 30 * 60 * 1000;
 const RECYCLE_AFTER_FAILURES = 5;
+// webserver/server.js reports capture unhealthy after HEALTHCHECK_WINDOW
+// without a package_exists message, so the loop never waits longer than the
+// window less HEARTBEAT_MARGIN_MS (time for a capture and its detection).
+// That is also the default heartbeat with --events.
+const HEALTHCHECK_WINDOW = process.env.HEALTHCHECK_WINDOW || "10m";
+const HEALTHCHECK_WINDOW_MS = parseDuration(HEALTHCHECK_WINDOW);
+const HEARTBEAT_MARGIN_MS = 2 * 60 * 1000;
+const MAX_LOOP_INTERVAL_MS = HEALTHCHECK_WINDOW_MS - HEARTBEAT_MARGIN_MS;
+// Without --loop or --events, capture.js runs one cycle and exits
+const ONE_SHOT =
+  !process.argv.includes("--events") &&
+  !(process.argv.includes("--loop") && process.argv[process.argv.indexOf("--loop") + 1]);
+const ONE_SHOT_PUBLISH_TIMEOUT_MS = 10000;
+const EVENT_TRIGGER_MIN_GAP_MS = 30 * 1000; // Per-camera debounce for motion/person/ring
+const POLICY_HISTORY_LENGTH = 50;
+const KEEP_WARM_CHECK_MS = 30 * 1000; // How often --keep-warm re-opens dropped P2P sessions
+const DETECTION_WORKERS = parseInt(process.env.DETECTION_WORKERS || "2");
+const DETECTION_QUEUE_LIMIT = parseInt(process.env.DETECTION_QUEUE_LIMIT || "4");
+// Annotated images are rendered after publishing: every new positive, and 1
+// in ANNOTATE_NEGATIVE_EVERY other frames per camera
+const ANNOTATE_NEGATIVE_EVERY = parseInt(process.env.ANNOTATE_NEGATIVE_EVERY || "10");
+const ANNOTATION_CONCURRENCY = 1;
+const ANNOTATION_QUEUE_LIMIT = 8;
+// Reuse an earlier result while the doorstep looks unchanged. CHANGE_GATE=1
+// compares with the last frame sent to the LLM, CHANGE_GATE=background with
+// a running background model, CHANGE_GATE=phash looks the frame up in a
+// perceptual-hash cache of earlier results. Off by default.
+const CHANGE_GATE = process.env.CHANGE_GATE || "0";
+const CHANGE_GATE_PIXEL_DELTA = parseInt(process.env.CHANGE_GATE_PIXEL_DELTA || "25");
+const CHANGE_GATE_MAX_MEAN_DIFF = parseFloat(process.env.CHANGE_GATE_MAX_MEAN_DIFF || "4");
+const CHANGE_GATE_MAX_CHANGED_FRACTION = parseFloat(process.env.CHANGE_GATE_MAX_CHANGED_FRACTION || "0.01");
+const CHANGE_GATE_MAX_REUSE = process.env.CHANGE_GATE_MAX_REUSE || "30m";
+const PHASH_CACHE_FILE = `${DATA_DIR}/detection-cache.json`;
+const PHASH_CACHE_SIZE = parseInt(process.env.PHASH_CACHE_SIZE || "256");
+const PHASH_CACHE_TTL = process.env.PHASH_CACHE_TTL || "6h";
+const PHASH_MAX_DISTANCE = parseInt(process.env.PHASH_MAX_DISTANCE || "2");
+const BACKGROUND_STATE_FILE = `${DATA_DIR}/background-model.json`;
+const BACKGROUND_LEARNING_RATE = parseFloat(process.env.BACKGROUND_LEARNING_RATE || "0.1");
+const BACKGROUND_PIXEL_DELTA = parseInt(process.env.BACKGROUND_PIXEL_DELTA || "30");
+const BACKGROUND_MIN_BLOB_FRACTION = parseFloat(process.env.BACKGROUND_MIN_BLOB_FRACTION || "0.005");
+const BACKGROUND_STATIONARY_FRAMES = parseInt(process.env.BACKGROUND_STATIONARY_FRAMES || "2");
 const FFMPEG_QUALITY = "2";
+const FFMPEG_POOL_SIZE = parseInt(process.env.FFMPEG_POOL_SIZE || "1"); // warm decoders per codec
+const FFMPEG_WORKER_MAX_USES = parseInt(process.env.FFMPEG_WORKER_MAX_USES || "20");
 const SAVE_RAW_VIDEO = true;
-const TARGET_CAMERA_NAME = "775";
+const VIDEO_RING_GB = parseFloat(process.env.VIDEO_RING_GB || "2");
+// SNAPSHOT_STORE=1 keeps frames in a content-addressed store instead of one
+// file per frame in snapshots/. With SNAPSHOT_NEAR_DUPLICATE_DISTANCE >= 0, a
+// frame that close (pHash bits) to a recent one is stored as a reference to it.
+const SNAPSHOT_STORE = process.env.SNAPSHOT_STORE === "1";
+const SNAPSHOT_NEAR_DUPLICATE_DISTANCE = parseInt(process.env.SNAPSHOT_NEAR_DUPLICATE_DISTANCE || "-1");
+// Captured files are deleted once older than RETENTION_MAX_AGE, and oldest
+// first while those outside the video ring and store total more than
+// RETENTION_MAX_GB (0 = no quota)
+const RETENTION_MAX_AGE = process.env.RETENTION_MAX_AGE || "168h";
+const RETENTION_MAX_GB = parseFloat(process.env.RETENTION_MAX_GB || "0");
+const RETENTION_MAX_AGE_MS = parseDuration(RETENTION_MAX_AGE);
+// Directories under OUTPUT_ROOT that expire their own files
+const SELF_MANAGED_DIRS = [path.basename(VIDEO_RING_DIR), path.basename(SNAPSHOT_STORE_DIR)];
+// Comma-separated camera name fragments, e.g. CAMERA_NAMES="775,back door"
+const TARGET_CAMERA_NAMES = (process.env.CAMERA_NAMES || "775")
+  .split(",")
+  .map((name) => name.trim())
+  .filter(Boolean);
+const MAX_LIVESTREAMS_PER_STATION = parseInt(process.env.MAX_LIVESTREAMS_PER_STATION || "1");
+// Per-camera doorstep polygons; cameras without one use the bottom band
+const CAMERA_ROI_FILE = process.env.CAMERA_ROI_FILE || "./camera-roi.json";
 
 // Load Eufy credentials from environment variables
 if (!process.env.EUFY_USERNAME) {
@@ -39,6 +120,15 @@ if (!process.env.EUFY_PASSWORD) {
   logger.error("EUFY_PASSWORD environment variable is not set");
   process.exit(1);
 }
+if (!RETENTION_MAX_AGE_MS) {
+  logger.error("Invalid RETENTION_MAX_AGE. Use format: 60s, 5m, 1h");
+  process.exit(1);
+}
+
+if (!HEALTHCHECK_WINDOW_MS || MAX_LOOP_INTERVAL_MS <= 0) {
+  logger.error(`Invalid HEALTHCHECK_WINDOW. Use a duration over ${HEARTBEAT_MARGIN_MS / 60000}m, e.g. 10m`);
+  process.exit(1);
+}
 
 const eufyConfig = {
   username: process.env.EUFY_USERNAME,
@@ -54,6 +144,30 @@ const eufyConfig = {
   },
 };
 
+/**
+ * Doorstep polygons from CAMERA_ROI_FILE: {"<camera key>": [[x, y], ...]},
+ * points as fractions of frame width and height
+ * @returns {Map<string, Array<[number, number]>>}
+ */
+function loadCameraRois() {
+  const rois = new Map();
+  if (!fs.existsSync(CAMERA_ROI_FILE)) return rois;
+  try {
+    const config = JSON.parse(fs.readFileSync(CAMERA_ROI_FILE, "utf-8"));
+    for (const [key, roi] of Object.entries(config)) {
+      validateRoi(roi);
+      rois.set(key, roi);
+    }
+  } catch (error) {
+    logger.error(`Invalid ${CAMERA_ROI_FILE}: ${error.message}`);
+    process.exit(1);
+  }
+  logger.info("Loaded camera ROIs", { cameras: [...rois.keys()] });
+  return rois;
+}
+
+const cameraRois = loadCameraRois();
+
 // Eufy logger that uses our Winston logger
 const consoleLogger = {
   trace: (message, ...args) => {}, // Suppress trace
@@ -64,52 +178,42 @@ const consoleLogger = {
   fatal: (message, ...args) => logger.error(`[EUFY] ${message}`, { args }),
 };
 
+// Raw video from every capture shares one fixed-size ring file
+let videoRing = null;
+let snapshotStore = null;
+let retention = null;
+let retentionScan = null; // Startup listing, awaited before a one-shot run exits
+
 function ensureDirectories() {
-  [OUTPUT_ROOT, SNAPSHOTS_DIR, VIDEOS_DIR].forEach((dir) => {
+  [OUTPUT_ROOT, SNAPSHOTS_DIR].forEach((dir) => {
     if (!fs.existsSync(dir)) {
       fs.mkdirSync(dir, { recursive: true });
     }
   });
-}
-
-function createFFmpegProcess(codecExt, device, timestamp) {
-  const ffmpegArgs = [
-    "-f",
-    codecExt === "h265" ? "hevc" : "h264",
-    "-i",
-    "pipe:0",
-    "-vf",
-    `fps=1/${FRAME_CAPTURE_INTERVAL_S}`,
-    "-q:v",
-    FFMPEG_QUALITY,
-    `${SNAPSHOTS_DIR}/frame_${device.getSerial()}_${timestamp}_%03d.jpg`,
-  ];
-
-  const ffmpegProcess = spawn("ffmpeg", ffmpegArgs);
-
-  ffmpegProcess.stdout.on("data", (data) => {
-    logger.debug("FFmpeg stdout", { data: data.toString() });
-  });
-
-  ffmpegProcess.stderr.on("data", (data) => {
-    const message = data.toString();
-    if (message.includes("frame=")) {
-      const frameMatch = message.match(/frame=\s*(\d+)/);
-      if (frameMatch) {
-        logger.info("Captured frame", { frame: frameMatch[1] });
-      }
-    }
-  });
-
-  ffmpegProcess.on("close", (code) => {
-    logger.debug("FFmpeg process exited", { code });
-  });
-
-  ffmpegProcess.on("error", (err) => {
-    logger.error("FFmpeg process error", { error: err.message });
-  });
-
-  return ffmpegProcess;
+  if (SAVE_RAW_VIDEO && !videoRing) {
+    videoRing = openVideoRingStore(VIDEO_RING_DIR, VIDEO_RING_GB * 1024 ** 3);
+  }
+  if (SNAPSHOT_STORE && !snapshotStore) {
+    snapshotStore = createSnapshotStore({
+      dir: SNAPSHOT_STORE_DIR,
+      maxAgeMs: RETENTION_MAX_AGE_MS,
+      nearDuplicateDistance: SNAPSHOT_NEAR_DUPLICATE_DISTANCE,
+      metrics,
+    });
+  }
+  if (!retention) {
+    retention = createRetentionManager({
+      root: OUTPUT_ROOT,
+      excludeDirs: SELF_MANAGED_DIRS,
+      maxAgeMs: RETENTION_MAX_AGE_MS,
+      maxBytes: RETENTION_MAX_GB * 1024 ** 3,
+      metrics,
+    });
+    // Files from earlier runs; listed in the background, once
+    retentionScan = retention
+      .scan()
+      .catch((error) => logger.warn(`Could not scan ${OUTPUT_ROOT}: ${error.message}`));
+  }
 }
 
 async function handleLivestreamStart(
@@ -128,22 +232,48 @@ async function handleLivestreamStart(
   const timestamp = Date.now();
 
   try {
-    const ffmpegProcess = createFFmpegProcess(codecExt, device, timestamp);
-    captureState.ffmpegProcess = ffmpegProcess;
+    const framePrefix = `${SNAPSHOTS_DIR}/frame_${device.getSerial()}_${timestamp}_`;
+    const frameWrites = [];
+    let frameNumber = 0;
+
+    const decoder = ffmpegPool.acquire(codecExt, (jpeg) => {
+      if (!captureState.firstFrameAt) captureState.firstFrameAt = Date.now();
+      frameNumber++;
+      // Kept in memory so detection never reads the frame back from disk.
+      // Scored while the capture is still running.
+      const frame = { path: null, stored: null, jpeg, quality: null };
+      if (snapshotStore) {
+        // The path is the blob's, which a near-duplicate shares with an earlier frame
+        frameWrites.push(
+          snapshotStore.put(captureState.cameraKey, jpeg, captureState.roi).then((stored) => {
+            frame.path = stored.path;
+            frame.stored = stored;
+          })
+        );
+      } else {
+        const framePath = `${framePrefix}${String(frameNumber).padStart(3, "0")}.jpg`;
+        frame.path = framePath;
+        frameWrites.push(fs.promises.writeFile(framePath, jpeg).then(() => retention.track(framePath, jpeg.length)));
+      }
+      if (FRAME_SELECTION === "best") {
+        frame.quality = scoreCapturedFrame(jpeg, captureState.roi);
+      }
+      captureState.frames.push(frame);
+      logger.info("Captured frame", { frame: frameNumber });
+    });
+    captureState.decoder = decoder;
 
     videoStream.on("data", (chunk) => {
       logger.debug("Received video chunk", { size: chunk.length });
-      if (!ffmpegProcess.stdin.destroyed) {
-        ffmpegProcess.stdin.write(chunk);
-      }
+      if (!captureState.firstChunkAt) captureState.firstChunkAt = Date.now();
+      decoder.write(chunk);
     });
 
-    let writeStream;
+    let recording;
     if (SAVE_RAW_VIDEO) {
-      const outputPath = `${VIDEOS_DIR}/capture_${device.getSerial()}_${timestamp}.${codecExt}`;
-      writeStream = fs.createWriteStream(outputPath);
+      recording = videoRing.openRecord({ serial: device.getSerial(), codec: codecExt });
       videoStream.on("data", (chunk) => {
-        writeStream.write(chunk);
+        recording.write(chunk);
       });
     }
 
@@ -152,30 +282,37 @@ async function handleLivestreamStart(
         `Stopping capture after ${CAPTURE_DURATION_MS / 1000} seconds...`
       );
 
-      if (!ffmpegProcess.stdin.destroyed) {
-        ffmpegProcess.stdin.end();
-      }
+      // Nothing awaits this callback, so it must always mark the capture
+      // complete itself, or captureVideo() waits out its timeout
+      try {
+        // Waits for frames still in the decoder, then returns it to the pool
+        await decoder.finish();
+        await Promise.all(frameWrites);
 
-      if (writeStream) {
-        writeStream.end();
-      }
+        if (recording) {
+          await recording.close();
+        }
 
-      await new Promise((resolve) => setTimeout(resolve, 1000));
-      await eufy.stopStationLivestream(device.getSerial());
+        // Store the frame pattern for package detection; the frames are
+        // usable even if stopping the livestream fails
+        captureState.framePattern = framePrefix;
 
-      logger.info("Capture complete!");
-      logger.info(
-        `Screenshots saved to: ${SNAPSHOTS_DIR}/frame_${device.getSerial()}_${timestamp}_*.jpg`
-      );
-      if (SAVE_RAW_VIDEO) {
+        await eufy.stopStationLivestream(device.getSerial());
+
+        logger.info("Capture complete!");
         logger.info(
-          `Raw video saved to: ${VIDEOS_DIR}/capture_${device.getSerial()}_${timestamp}.${codecExt}`
+          snapshotStore
+            ? `Screenshots saved to: ${SNAPSHOT_STORE_DIR}`
+            : `Screenshots saved to: ${SNAPSHOTS_DIR}/frame_${device.getSerial()}_${timestamp}_*.jpg`
         );
+        if (recording) {
+          logger.info(`Raw video saved to ring: ${VIDEO_RING_DIR} (record ${recording.id})`);
+        }
+      } catch (error) {
+        logger.error("Error finishing capture", { device: device.getName(), error: error.message });
+      } finally {
+        captureState.complete = true;
       }
-
-      // Store the frame pattern for package detection
-      captureState.framePattern = `${SNAPSHOTS_DIR}/frame_${device.getSerial()}_${timestamp}_`;
-      captureState.complete = true;
     }, CAPTURE_DURATION_MS);
   } catch (error) {
     logger.error("Error capturing video:", { error: error.message });
@@ -184,68 +321,280 @@ async function handleLivestreamStart(
 }
 
 /**
- * Find the latest captured frame matching a pattern
- * @param {string} pattern - Frame pattern prefix
- * @returns {string|null} - Path to the latest frame or null
+ * Quality score of one captured frame's doorstep region
+ * @returns {Promise<{sharpness: number, exposure: number, score: number}|null>} - null if it
+ *   could not be scored
  */
-function findLatestFrame(pattern) {
-  const dir = path.dirname(pattern);
-  const prefix = path.basename(pattern);
-
-  if (!fs.existsSync(dir)) {
+async function scoreCapturedFrame(jpeg, roi) {
+  const startedAt = performance.now();
+  try {
+    const quality = scoreFrame(await roiThumbnail(jpeg, QUALITY_WIDTH, roi));
+    metrics.observe("frame_quality_ms", Math.round(performance.now() - startedAt));
+    return quality;
+  } catch (error) {
+    logger.debug(`Could not score frame: ${error.message}`);
     return null;
   }
+}
 
-  const files = fs.readdirSync(dir).filter((f) => f.startsWith(prefix) && f.endsWith(".jpg"));
-
-  if (files.length === 0) {
-    return null;
+/**
+ * Pick the frame to run detection on: the newest, unless it is clearly worse
+ * than the rest of the capture (below FRAME_SELECTION_MIN_RATIO of the
+ * median score), in which case the best-scoring one. Always the newest with
+ * FRAME_SELECTION=latest or when it could not be compared.
+ * @param {Array<{path: string, jpeg: Buffer, quality: Promise|null}>} frames - In capture order
+ */
+async function selectFrame(frames, target, trace) {
+  const latest = frames[frames.length - 1];
+  if (FRAME_SELECTION !== "best" || frames.length === 1) return latest;
+
+  const startedAt = Date.now();
+  const qualities = await Promise.all(frames.map((f) => f.quality));
+  const scores = qualities.filter(Boolean).map((q) => q.score).sort((a, b) => a - b);
+  const median = scores.length > 0 ? scores[Math.floor(scores.length / 2)] : 0;
+  const latestQuality = qualities[frames.length - 1];
+  let best = frames.length - 1;
+  if (latestQuality && latestQuality.score < median * FRAME_SELECTION_MIN_RATIO) {
+    for (let i = frames.length - 2; i >= 0; i--) {
+      if (qualities[i] && qualities[i].score > qualities[best].score) best = i;
+    }
   }
+  trace.record("frame_select", startedAt, Date.now(), { camera: target.key, frames: frames.length, best });
+
+  if (best !== frames.length - 1) {
+    metrics.increment("frame_selected_earlier");
+    logger.info("Using an earlier frame with better quality", {
+      camera: target.key,
+      frame: frames[best].path,
+      quality: qualities[best],
+      latestQuality,
+      median,
+    });
+  }
+  return frames[best];
+}
 
-  // Sort by frame number (descending) and return the latest
-  files.sort((a, b) => {
-    const numA = parseInt(a.match(/_(\d+)\.jpg$/)?.[1] || "0");
-    const numB = parseInt(b.match(/_(\d+)\.jpg$/)?.[1] || "0");
-    return numB - numA;
-  });
+/**
+ * Camera key used to namespace MQTT topics and state files
+ * @param {string} name - Configured camera name fragment
+ * @returns {string} - e.g. "Back Door" -> "back-door"
+ */
+function cameraKey(name) {
+  return name.toLowerCase().replace(/[^a-z0-9]+/g, "-").replace(/^-+|-+$/g, "");
+}
 
-  return path.join(dir, files[0]);
+function imageStateFile(key) {
+  return `${DATA_DIR}/image-state-${key}.json`;
 }
 
-function findTargetCamera(cameras) {
-  for (const camera of cameras) {
-    if (camera.getName().toLowerCase().includes(TARGET_CAMERA_NAME)) {
-      return camera;
+function matchesCameraName(device, name) {
+  return device.getName().toLowerCase().includes(name.toLowerCase());
+}
+
+/**
+ * Re-match configured camera names against the registry's cameras. Runs on
+ * registry changes only, so capture cycles look targets up directly.
+ */
+function refreshTargets() {
+  const cameras = registry.devices().filter((device) => device instanceof Camera);
+  const next = new Map();
+
+  for (const name of TARGET_CAMERA_NAMES) {
+    const device =
+      registry.getDeviceByName(name) || cameras.find((camera) => matchesCameraName(camera, name));
+    if (!device) {
+      if (targetsByName.has(name)) {
+        logger.event("capture_camera_missing", `Target camera "${name}" was removed`, {
+          serial: targetsByName.get(name).device.getSerial(),
+        });
+      }
+      continue;
     }
+    if (targetsByName.get(name)?.device !== device) {
+      logger.info(`Target camera "${name}" is ${device.getName()} (${device.getSerial()})`);
+    }
+    const key = cameraKey(name);
+    next.set(name, {
+      key,
+      name: device.getName(),
+      device,
+      stationSerial: device.getStationSerial(),
+      roi: cameraRois.get(key) || null,
+    });
   }
-  throw new Error(
-    `Target camera "${TARGET_CAMERA_NAME}" not found. Instead found: ${cameras
-      .map((c) => c.getName())
-      .join(", ")}`
-  );
+
+  targetsByName = next;
+  currentTargets = [...next.values()];
+  targetsBySerial = new Map(currentTargets.map((t) => [t.device.getSerial(), t]));
 }
 
 // Persistent Eufy client shared across loop iterations. Re-creating it every
 // iteration meant ~1440 password logins/day, which eventually trips Eufy's
 // captcha challenge.
 let eufy = null;
+let registry = null; // Device registry of the current client
+let targetsByName = new Map(); // configured camera name -> target
+let targetsBySerial = new Map(); // device serial -> target
 let authError = null;
-let currentCaptureState = null;
+const captureStates = new Map(); // device serial -> capture state of the in-flight capture
 let consecutiveFailures = 0;
+const scheduler = createCaptureScheduler({ maxPerStation: MAX_LIVESTREAMS_PER_STATION });
+const metrics = createMetrics("capture");
+const tracer = createTracer("capture", { metrics });
+
+// Capture and detection are pipelined: frames go to a bounded queue served
+// by worker threads, so the capture stage never waits on the LLM.
+const detectionPool = createDetectionPool({
+  size: DETECTION_WORKERS,
+  queueLimit: DETECTION_QUEUE_LIMIT,
+  metrics,
+});
+function createGate() {
+  if (CHANGE_GATE === "background") {
+    return createBackgroundModel({
+      stateFile: BACKGROUND_STATE_FILE,
+      learningRate: BACKGROUND_LEARNING_RATE,
+      pixelDelta: BACKGROUND_PIXEL_DELTA,
+      minBlobFraction: BACKGROUND_MIN_BLOB_FRACTION,
+      stationaryFrames: BACKGROUND_STATIONARY_FRAMES,
+      maxReuseMs: parseDuration(CHANGE_GATE_MAX_REUSE),
+      metrics,
+    });
+  }
+  if (CHANGE_GATE === "phash") {
+    return createPhashCache({
+      stateFile: PHASH_CACHE_FILE,
+      capacity: PHASH_CACHE_SIZE,
+      ttlMs: parseDuration(PHASH_CACHE_TTL),
+      maxDistance: PHASH_MAX_DISTANCE,
+      metrics,
+    });
+  }
+  if (CHANGE_GATE === "1") {
+    return createChangeGate({
+      pixelDelta: CHANGE_GATE_PIXEL_DELTA,
+      maxMeanDiff: CHANGE_GATE_MAX_MEAN_DIFF,
+      maxChangedFraction: CHANGE_GATE_MAX_CHANGED_FRACTION,
+      maxReuseMs: parseDuration(CHANGE_GATE_MAX_REUSE),
+      metrics,
+    });
+  }
+  return null;
+}
+const changeGate = createGate();
+const annotationQueue = createAnnotationQueue({
+  concurrency: ANNOTATION_CONCURRENCY,
+  queueLimit: ANNOTATION_QUEUE_LIMIT,
+  sampleEvery: ANNOTATE_NEGATIVE_EVERY,
+  metrics,
+  onRendered: (outputPath) => retention?.track(outputPath),
+});
+const capturedSeqByCamera = new Map(); // camera key -> seq of the latest captured frame
+const appliedSeqByCamera = new Map(); // camera key -> seq of the latest published result
+const publishChains = new Map(); // camera key -> last queued publish
+
+// One MQTT connection for the life of the process. It reconnects on its
+// own and queues results published while the broker is unreachable.
+const mqttPublisher = createPublisher("capture", {
+  // A one-shot run fails rather than hang while the broker is down; the
+  // loop keeps results queued until it comes back
+  timeoutMs: ONE_SHOT ? ONE_SHOT_PUBLISH_TIMEOUT_MS : 0,
+});
+
+// Decoders kept running between captures so the first chunk never waits on
+// an ffmpeg spawn
+const ffmpegPool = createFFmpegPool({
+  size: FFMPEG_POOL_SIZE,
+  maxUses: FFMPEG_WORKER_MAX_USES,
+  sampleIntervalS: FRAME_CAPTURE_INTERVAL_S,
+  quality: FFMPEG_QUALITY,
+  metrics,
+});
+
+// Station P2P sessions are opened before the livestream command, and with
+// --keep-warm held open between captures. Not while the client is being
+// recycled or backing off from an auth failure.
+const stationSessions = createStationSessions(
+  () => (eufy && eufy.isConnected() && !authError && !connectPromise ? eufy : null),
+  { keepWarmIntervalMs: KEEP_WARM_CHECK_MS, metrics }
+);
+
+// Event-triggered capture (--events)
+let eventTriggersEnabled = false;
+let currentTargets = [];
+const lastTriggerAt = new Map(); // camera key -> ms
+
+// Inputs to the capture interval policy (--policy). history holds one entry
+// per cycle: whether any camera currently sees a package.
+const scheduleState = { history: [], lastMotionAt: null, lastTransitionAt: null };
+const lastResultByCamera = new Map(); // camera key -> package detected
+let wakeLoop = null; // Cuts the current loop sleep short so the policy can re-evaluate
+
+function recordDetection(cameraKey, detected) {
+  const previous = lastResultByCamera.get(cameraKey);
+  if (previous !== undefined && previous !== detected) {
+    scheduleState.lastTransitionAt = Date.now();
+  }
+  lastResultByCamera.set(cameraKey, detected);
+}
 
-async function createEufyClient() {
-  const client = await EufySecurity.initialize(eufyConfig, consoleLogger);
+function recordCycle() {
+  scheduleState.history.push({
+    at: Date.now(),
+    detected: [...lastResultByCamera.values()].some(Boolean),
+  });
+  if (scheduleState.history.length > POLICY_HISTORY_LENGTH) {
+    scheduleState.history.shift();
+  }
+}
 
-  client.on("device added", (device) => {
-    logger.info(`Device found: ${device.getName()} (${device.getSerial()})`);
+/**
+ * Start an immediate capture of the camera that raised a motion, person or
+ * ring event. Events for unconfigured cameras and repeats within
+ * EVENT_TRIGGER_MIN_GAP_MS are ignored.
+ */
+function onDeviceEvent(device, state, reason) {
+  if (!state) return;
+
+  const target = targetsBySerial.get(device.getSerial());
+  if (!target) return;
+
+  // Activity speeds up adaptive polling even when events do not trigger captures
+  scheduleState.lastMotionAt = Date.now();
+  if (wakeLoop) wakeLoop();
+
+  // While backing off from an auth failure, an event must not trigger a login
+  if (!eventTriggersEnabled || authError) return;
+
+  const now = Date.now();
+  const sinceLast = now - (lastTriggerAt.get(target.key) || 0);
+  if (sinceLast < EVENT_TRIGGER_MIN_GAP_MS) {
+    logger.debug("Ignoring repeated device event", { camera: target.key, reason, sinceLast });
+    return;
+  }
+  lastTriggerAt.set(target.key, now);
+
+  logger.event("capture_trigger", `Capture triggered by ${reason}`, {
+    camera: target.key,
+    reason,
   });
-  client.on("station added", (station) => {
-    logger.info(`Station found: ${station.getName()} (${station.getSerial()})`);
+  metrics.increment(`trigger_${reason}`);
+  runOnce({ reason, cameraKeys: [target.key], triggeredAt: now }).catch((error) => {
+    logger.error("Triggered capture failed", { camera: target.key, error: error.message });
   });
+}
+
+async function createEufyClient() {
+  const client = await EufySecurity.initialize(eufyConfig, consoleLogger);
+
+  registry = createDeviceRegistry(client);
+  targetsByName = new Map();
+  refreshTargets();
+  registry.onChange(refreshTargets);
 
   // Surface auth failures that eufy-security-client emits as events but
   // does not throw from connect(). Without these handlers the loop hangs
-  // silently at getDevices().
+  // silently waiting for devices.
   client.on("captcha request", (captchaId) => {
     logger.event("capture_auth_failure", "Eufy login requires CAPTCHA", { captchaId });
     authError = new Error(
@@ -263,12 +612,17 @@ async function createEufyClient() {
     authError = new Error(`Eufy connection error: ${err?.message || err}`);
   });
 
+  client.on("device motion detected", (device, state) => onDeviceEvent(device, state, "motion"));
+  client.on("device person detected", (device, state) => onDeviceEvent(device, state, "person"));
+  client.on("device rings", (device, state) => onDeviceEvent(device, state, "ring"));
+
   client.on(
     "station livestream start",
     async (station, device, metadata, videoStream, audioStream) => {
-      if (currentCaptureState) {
+      const captureState = captureStates.get(device.getSerial());
+      if (captureState) {
         await handleLivestreamStart(
-          station, device, metadata, videoStream, audioStream, client, currentCaptureState
+          station, device, metadata, videoStream, audioStream, client, captureState
         );
       }
     }
@@ -277,13 +631,93 @@ async function createEufyClient() {
   return client;
 }
 
+const processStartedAt = Date.now();
+let firstCaptureRecorded = false;
+
+/**
+ * Resolve once every configured camera has been added by a freshly
+ * connected client; reject on captcha/2FA/connection errors. Must be set up
+ * before connect() so no event is missed.
+ *
+ * If only some cameras show up before EUFY_READY_TIMEOUT_MS, resolve anyway
+ * and let the cycle report the missing ones.
+ */
+function waitForEufyReady(client) {
+  return new Promise((resolve, reject) => {
+    const pendingNames = new Set(TARGET_CAMERA_NAMES);
+    let connected = false;
+
+    const listeners = {
+      "connect": () => {
+        connected = true;
+        logger.debug("Eufy cloud login complete");
+        check();
+      },
+      "device added": (device) => {
+        for (const name of pendingNames) {
+          if (matchesCameraName(device, name)) pendingNames.delete(name);
+        }
+        check();
+      },
+      "captcha request": () => finish(authError),
+      "tfa request": () => finish(authError),
+      "connection error": () => finish(authError),
+    };
+
+    const timer = setTimeout(() => {
+      if (connected && pendingNames.size < TARGET_CAMERA_NAMES.length) {
+        logger.warn("Eufy ready without all cameras", { missing: [...pendingNames] });
+        finish();
+      } else {
+        finish(new Error(
+          `Eufy not ready after ${EUFY_READY_TIMEOUT_MS}ms ` +
+          `(connected=${connected}, missing cameras: ${[...pendingNames].join(", ")})`
+        ));
+      }
+    }, EUFY_READY_TIMEOUT_MS);
+
+    function check() {
+      // "device added" can arrive before or after "connect"
+      if (pendingNames.size === 0 && (connected || client.isConnected())) finish();
+    }
+
+    function finish(error) {
+      clearTimeout(timer);
+      for (const [event, listener] of Object.entries(listeners)) {
+        client.removeListener(event, listener);
+      }
+      if (error) reject(error);
+      else resolve();
+    }
+
+    for (const [event, listener] of Object.entries(listeners)) {
+      client.on(event, listener);
+    }
+  });
+}
+
+// Triggered and polled runs can overlap; they share one connect attempt.
+let connectPromise = null;
+
 async function ensureEufyConnected() {
+  if (!connectPromise) {
+    connectPromise = connectEufyIfNeeded().finally(() => {
+      connectPromise = null;
+    });
+  }
+  return connectPromise;
+}
+
+/**
+ * @returns {Promise<boolean>} - Whether a new client was connected
+ */
+async function connectEufyIfNeeded() {
   const needsRecycle =
     !eufy ||
     !eufy.isConnected() ||
     authError !== null ||
     consecutiveFailures >= RECYCLE_AFTER_FAILURES;
-  if (!needsRecycle) return;
+  if (!needsRecycle) return false;
 
   if (eufy) {
     logger.info("Recycling Eufy client", {
@@ -294,60 +728,132 @@ async function ensureEufyConnected() {
   }
   authError = null;
   consecutiveFailures = 0;
+  const connectStartedAt = Date.now();
   eufy = await createEufyClient();
+  const ready = waitForEufyReady(eufy);
   logger.info("Logging in to Eufy...");
-  await eufy.connect();
-  await new Promise((r) => setTimeout(r, DEVICE_DISCOVERY_TIMEOUT_MS));
+  // Awaited together so a connect() that throws does not leave the ready
+  // promise to reject later with no handler
+  await Promise.all([eufy.connect(), ready]);
 
   if (authError) throw authError;
-  if (!eufy.isConnected()) {
+  const readyMs = Date.now() - connectStartedAt;
+  metrics.observe("eufy_ready_ms", readyMs);
+  logger.info("Connected successfully!", { readyMs });
+  return true;
+}
+
+/**
+ * Targets for this cycle, from the registry-maintained map
+ * @returns {Array<{key: string, name: string, device: Camera, stationSerial: string, roi: Array|null}>}
+ */
+function resolveTargetCameras() {
+  const found = registry.devices().map((d) => d.getName());
+
+  for (const name of TARGET_CAMERA_NAMES) {
+    if (!targetsByName.has(name)) {
+      logger.event("capture_camera_missing", `Target camera "${name}" not found`, { found });
+    }
+  }
+
+  if (currentTargets.length === 0) {
     throw new Error(
-      "Eufy connect() returned but isConnected()=false after " +
-      `${DEVICE_DISCOVERY_TIMEOUT_MS}ms; login likely failed silently`
+      `Target cameras "${TARGET_CAMERA_NAMES.join(", ")}" not found. Instead found: ${found.join(", ")}`
     );
   }
-  logger.info("Connected successfully!");
-}
 
-async function captureVideo() {
-  logger.event("capture_start", "Starting capture process");
-  ensureDirectories();
+  return currentTargets;
+}
 
-  await ensureEufyConnected();
+async function captureVideo(target, trace) {
+  const targetDevice = target.device;
+  const serial = targetDevice.getSerial();
+  logger.event("capture_start", "Starting capture process", { camera: target.key });
 
-  currentCaptureState = {
+  const captureState = {
     complete: false,
-    ffmpegProcess: null,
+    decoder: null,
     framePattern: null,
+    firstChunkAt: null,
+    firstFrameAt: null,
+    frames: [], // {path, stored, jpeg, quality} per frame, in capture order
+    cameraKey: target.key,
+    roi: target.roi,
   };
+  captureStates.set(serial, captureState);
 
-  const devices = await eufy.getDevices();
-  const cameras = devices.filter((device) => device instanceof Camera);
+  try {
+    logger.info(`Using camera: ${targetDevice.getName()}`);
+
+    const startedAt = Date.now();
+    let session = { warm: false, connectMs: 0 };
+    try {
+      session = await stationSessions.ensureConnected(target.stationSerial);
+    } catch (error) {
+      // startStationLivestream() opens the session itself as a fallback
+      logger.warn("Could not open station P2P session", {
+        camera: target.key,
+        error: error.message,
+      });
+    }
 
-  if (cameras.length === 0) {
-    logger.warn("No cameras found!");
-    return currentCaptureState;
-  }
+    logger.info("Starting livestream to capture video...", {
+      camera: target.key,
+      warm: session.warm,
+    });
+    const commandSentAt = Date.now();
+    await eufy.startStationLivestream(serial);
+    const commandMs = Date.now() - commandSentAt;
+    trace.record("livestream_start", commandSentAt, commandSentAt + commandMs, { camera: target.key });
+
+    let timeout = CAPTURE_TIMEOUT_MS;
+    const CHECK_INTERVAL_MS = 100;
+    while (!captureState.complete && timeout > 0) {
+      await new Promise((resolve) => setTimeout(resolve, CHECK_INTERVAL_MS));
+      timeout -= CHECK_INTERVAL_MS;
+    }
 
-  const targetDevice = findTargetCamera(cameras);
-  logger.info(`Using camera: ${targetDevice.getName()}`);
+    if (!captureState.complete) {
+      logger.error("Capture timeout - stopping livestream", { camera: target.key });
+      await eufy.stopStationLivestream(serial);
+    }
 
-  logger.info("Starting livestream to capture video...");
-  await eufy.startStationLivestream(targetDevice.getSerial());
+    const spanAttrs = { camera: target.key, warm: session.warm };
+    if (!session.warm && session.connectMs > 0) {
+      trace.record("p2p_connect", startedAt, startedAt + session.connectMs, spanAttrs);
+    }
+    if (captureState.firstChunkAt) {
+      trace.record("first_chunk", commandSentAt, captureState.firstChunkAt, spanAttrs);
+    }
+    if (captureState.firstChunkAt && captureState.firstFrameAt) {
+      trace.record("first_frame", captureState.firstChunkAt, captureState.firstFrameAt, spanAttrs);
+    }
 
-  let timeout = CAPTURE_TIMEOUT_MS;
-  const CHECK_INTERVAL_MS = 100;
-  while (!currentCaptureState.complete && timeout > 0) {
-    await new Promise((resolve) => setTimeout(resolve, CHECK_INTERVAL_MS));
-    timeout -= CHECK_INTERVAL_MS;
-  }
+    if (captureState.firstChunkAt) {
+      const firstChunkMs = captureState.firstChunkAt - commandSentAt;
+      const totalMs = captureState.firstChunkAt - startedAt;
+      metrics.observe("livestream_command_ms", commandMs);
+      metrics.observe("livestream_first_chunk_ms", firstChunkMs);
+      metrics.observe(
+        session.warm ? "time_to_first_chunk_warm_ms" : "time_to_first_chunk_cold_ms",
+        totalMs
+      );
+      logger.event("livestream_timing", "Livestream phase timing", {
+        camera: target.key,
+        warm: session.warm,
+        p2pConnectMs: session.connectMs,
+        commandMs,
+        firstChunkMs,
+        totalMs,
+      });
+    }
 
-  if (!currentCaptureState.complete) {
-    logger.error("Capture timeout - stopping livestream");
-    await eufy.stopStationLivestream(targetDevice.getSerial());
+    return captureState;
+  } finally {
+    if (captureStates.get(serial) === captureState) {
+      captureStates.delete(serial);
+    }
   }
-
-  return currentCaptureState;
 }
 
 function checkCooldownState() {
@@ -374,157 +880,436 @@ function checkCooldownState() {
   }
 }
 
-async function runOnce() {
-  let packageDetected = false;
-  let mqttClient = null;
+/**
+ * Capture stage for a single camera: livestream until a frame is saved
+ * @param {object} target - Camera from resolveTargetCameras()
+ * @param {object} trace - Trace of the current cycle
+ * @returns {Promise<{framePath: string, stored: object|null, jpeg: Buffer, seq: number}>} - seq orders
+ *   this camera's frames; stored is the frame's snapshot store entry from put(), if enabled
+ */
+async function captureFrame(target, trace) {
+  // Capture video and frames. Hard-bound with a timeout so a hang
+  // anywhere inside the eufy client (livestream, etc.) produces a
+  // capture_error instead of deadlocking the loop.
+  let timeoutHandle;
+  const captureState = await Promise.race([
+    captureVideo(target, trace),
+    new Promise((_, reject) => {
+      timeoutHandle = setTimeout(
+        () => reject(new Error(`captureVideo() exceeded ${RUN_ONCE_TIMEOUT_MS}ms`)),
+        RUN_ONCE_TIMEOUT_MS
+      );
+    }),
+  ]).finally(() => clearTimeout(timeoutHandle));
 
-  // Check cooldown state before capture
-  if (checkCooldownState()) {
-    logger.event("capture_skipped", "Capture skipped due to cooldown");
-    return;
+  if (!captureState.framePattern) {
+    throw new Error("Livestream never started (P2P command likely aged out); no frames captured");
   }
 
-  // Clean up old files
-  cleanupOldFiles();
+  if (!firstCaptureRecorded) {
+    firstCaptureRecorded = true;
+    const coldStartMs = Date.now() - processStartedAt;
+    metrics.observe("cold_start_to_first_capture_ms", coldStartMs);
+    logger.event("capture_cold_start", "First capture since process start", { coldStartMs });
+  }
 
-  try {
-    // Connect to MQTT broker
-    mqttClient = await createClient("capture");
-
-    // Capture video and frames. Hard-bound with a timeout so a hang
-    // anywhere inside the eufy client (getDevices, livestream, etc.)
-    // produces a capture_error instead of deadlocking the loop.
-    let timeoutHandle;
-    const captureState = await Promise.race([
-      captureVideo(),
-      new Promise((_, reject) => {
-        timeoutHandle = setTimeout(
-          () => reject(new Error(`captureVideo() exceeded ${RUN_ONCE_TIMEOUT_MS}ms`)),
-          RUN_ONCE_TIMEOUT_MS
-        );
-      }),
-    ]);
-    clearTimeout(timeoutHandle);
+  if (captureState.frames.length === 0) {
+    throw new Error("ffmpeg produced no frames from livestream");
+  }
+  const selected = await selectFrame(captureState.frames, target, trace);
 
-    if (!captureState.framePattern) {
-      throw new Error("Livestream never started (P2P command likely aged out); no frames captured");
+  const seq = (capturedSeqByCamera.get(target.key) || 0) + 1;
+  capturedSeqByCamera.set(target.key, seq);
+  return { framePath: selected.path, stored: selected.stored, jpeg: selected.jpeg, seq };
+}
+
+/**
+ * Detect one frame on the detection pool
+ * @returns {Promise<{result: object}>}
+ */
+async function runDetection(target, frame, trace) {
+  // Detection and the overlay run in a worker thread; replay their spans here
+  const submittedAt = Date.now();
+  let detection;
+  try {
+    detection = await detectionPool.submit({
+      cameraKey: target.key,
+      framePath: frame.framePath,
+      jpeg: frame.jpeg,
+      roi: target.roi,
+    });
+  } catch (error) {
+    for (const span of error.spans || []) {
+      trace.record(span.name, span.startMs, span.endMs, { camera: target.key, ...span.attrs });
     }
+    throw error;
+  }
+  trace.record("detection_queue", submittedAt, submittedAt + detection.queueWaitMs, {
+    camera: target.key,
+  });
+  for (const span of detection.spans) {
+    trace.record(span.name, span.startMs, span.endMs, { camera: target.key, ...span.attrs });
+  }
+
+  return { result: detection.result };
+}
 
-    // Find the latest captured frame
-    if (captureState.framePattern) {
-      const latestFrame = findLatestFrame(captureState.framePattern);
-      if (!latestFrame) {
-        throw new Error("ffmpeg produced no frames from livestream");
+/**
+ * Detection stage for one captured frame: detect on the detection pool,
+ * then write image state and publish. The annotated image is rendered
+ * afterwards, so publishing never waits on it.
+ *
+ * Results are applied in capture order per camera. A result that finishes
+ * after a newer frame's result was applied is dropped, and publishes for a
+ * camera are chained, so package_exists never goes back to an older state.
+ *
+ * @param {object} target - Camera the frame came from
+ * @param {{framePath: string, jpeg: Buffer, seq: number}} frame - From captureFrame()
+ * @param {{reason: string, triggeredAt: number|null}} trigger - What started this capture
+ * @param {object} trace - Trace of the cycle that captured the frame
+ * @returns {Promise<{packageDetected: boolean, stale: boolean}>}
+ */
+async function detectAndPublish(target, frame, trigger, trace) {
+  const startedAt = Date.now();
+  const { framePath } = frame;
+  logger.info(`Analyzing frame: ${framePath}`, { camera: target.key });
+
+  // An unchanged doorstep reuses the last result instead of calling the LLM
+  let gateCheck = null;
+  let detection = null;
+  if (changeGate) {
+    try {
+      const thumbnail = await trace.span(
+        "change_gate",
+        () => changeGate.thumbnail(frame.jpeg || framePath, target.roi),
+        { camera: target.key }
+      );
+      gateCheck = changeGate.check(target.key, thumbnail);
+      if (gateCheck.reuse) {
+        detection = gateCheck.reuse;
+        const { reuse, sample, ...gateStats } = gateCheck;
+        logger.info("Doorstep unchanged; reusing last detection", {
+          camera: target.key,
+          ...gateStats,
+        });
       }
+    } catch (error) {
+      logger.warn(`Change gate failed, detecting anyway: ${error.message}`);
+      gateCheck = null;
+    }
+  }
 
-      if (latestFrame) {
-        logger.info(`Analyzing latest frame: ${latestFrame}`);
+  const reused = detection !== null;
+  if (!reused) {
+    detection = await runDetection(target, frame, trace);
+    if (gateCheck) changeGate.remember(target.key, gateCheck, detection);
+  }
 
-        // Detect packages (cropping handled internally)
-        const result = await detectPackage(latestFrame);
-        packageDetected = result.package_detected;
+  const { result } = detection;
+  const packageDetected = result.package_detected;
 
-        logger.event("package_detection", "Package detection complete", {
-          detected: packageDetected,
-          confidence: result.confidence,
-          description: result.description,
-          frame: latestFrame,
-        });
+  if (frame.seq <= (appliedSeqByCamera.get(target.key) || 0)) {
+    metrics.increment("detections_stale_dropped");
+    logger.warn("Dropping detection result older than the last one published", {
+      camera: target.key,
+      seq: frame.seq,
+      applied: appliedSeqByCamera.get(target.key),
+    });
+    return { packageDetected, stale: true };
+  }
+  appliedSeqByCamera.set(target.key, frame.seq);
 
-        // Add text overlay to original image
-        let annotatedPath = null;
-        try {
-          annotatedPath = await addTextOverlay(latestFrame, result);
-          logger.info(`Created annotated image: ${annotatedPath}`);
-        } catch (overlayError) {
-          logger.warn(`Could not add text overlay: ${overlayError.message}`);
-        }
+  recordDetection(target.key, packageDetected);
+  if (!reused) {
+    metrics.increment(`detections_${trigger.reason}`);
+    metrics.increment(`detection_source_${result.source}`);
+  }
 
-        // Write image state for server.js to read when sending Slack notification
-        if (packageDetected) {
-          const imageToSend = annotatedPath || latestFrame;
-          const imageState = {
-            imagePath: path.resolve(imageToSend),
-            timestamp: new Date().toISOString(),
-            description: result.description,
-          };
-          fs.writeFileSync(IMAGE_STATE_FILE, JSON.stringify(imageState, null, 2));
-          logger.info("Wrote image state for Slack notification", { imagePath: imageState.imagePath });
-        }
-      }
+  // For event-triggered captures this is the end-to-end detection latency
+  // from the camera event; polled captures have no event to measure from.
+  const triggerLatencyMs = trigger.triggeredAt ? Date.now() - trigger.triggeredAt : undefined;
+  if (triggerLatencyMs !== undefined) {
+    metrics.observe("trigger_to_detection_ms", triggerLatencyMs);
+  }
+
+  logger.event("package_detection", "Package detection complete", {
+    camera: target.key,
+    trigger: trigger.reason,
+    triggerLatencyMs,
+    detected: packageDetected,
+    confidence: result.confidence,
+    description: result.description,
+    source: result.source,
+    frame: framePath,
+    reused: reused || undefined,
+  });
+  if (frame.stored) snapshotStore.record(target.key, frame.stored, result);
+
+  // Rendered in the background; null if this frame is not sampled
+  const annotatedPath = annotationQueue.submit({
+    cameraKey: target.key,
+    framePath,
+    jpeg: frame.jpeg,
+    result,
+    reused,
+    outputPath: frame.stored ? snapshotStore.annotatedPath(frame.stored.frame) : null,
+  });
+
+  const publish = async () => {
+    // Write image state for server.js to read when sending Slack notification.
+    // The annotated image may still be rendering; the server waits for it
+    // briefly and falls back to the plain frame.
+    if (packageDetected) {
+      const imageState = {
+        camera: target.key,
+        imagePath: path.resolve(framePath),
+        annotatedPath: annotatedPath ? path.resolve(annotatedPath) : undefined,
+        timestamp: new Date().toISOString(),
+        description: result.description,
+      };
+      fs.writeFileSync(imageStateFile(target.key), JSON.stringify(imageState, null, 2));
+      logger.info("Wrote image state for Slack notification", { imagePath: imageState.imagePath });
     }
 
     // Publish result to MQTT
-    await publishPackageStatus(mqttClient, packageDetected);
+    await trace.span(
+      "mqtt_publish",
+      (context) => publishPackageStatus(mqttPublisher, packageDetected, target.key, context),
+      { camera: target.key }
+    );
+  };
 
-    // Log success event for healthcheck
-    logger.event("capture_success", "Capture and detection complete", {
-      packageDetected,
-    });
+  // Queued behind this camera's previous publish, whether or not it succeeded
+  const published = (publishChains.get(target.key) || Promise.resolve()).then(publish, publish);
+  publishChains.set(target.key, published.catch(() => {}));
+  await published;
+  metrics.observe("frame_to_publish_ms", Date.now() - startedAt);
+
+  return { packageDetected, stale: false };
+}
+
+/**
+ * Run one capture cycle. Resolves once every camera has been captured;
+ * detection and publishing continue on the detection pool.
+ * @param {object} options
+ * @param {string} options.reason - "poll", or the device event that triggered the run
+ * @param {string[]|null} options.cameraKeys - Restrict to these cameras (default: all)
+ * @param {number|null} options.triggeredAt - When the triggering event arrived
+ * @returns {Promise<{detections: Promise<void>}>} - detections settles when this cycle's
+ *   results have been published (never rejects)
+ */
+async function runOnce({ reason = "poll", cameraKeys = null, triggeredAt = null } = {}) {
+  // Check cooldown state before capture
+  if (checkCooldownState()) {
+    logger.event("capture_skipped", "Capture skipped due to cooldown");
+    return { detections: Promise.resolve() };
+  }
+
+  const trace = tracer.startTrace("capture_cycle", { reason });
+  const captured = [];
+  const failures = []; // {camera?, error}
+
+  try {
+    ensureDirectories();
+
+    const connectStartedAt = Date.now();
+    if (await ensureEufyConnected()) {
+      trace.record("eufy_connect", connectStartedAt, Date.now());
+    }
+
+    const resolveStartedAt = Date.now();
+    const targets = resolveTargetCameras().filter(
+      (t) => !cameraKeys || cameraKeys.includes(t.key)
+    );
+    trace.record("get_devices", resolveStartedAt, Date.now(), { cameras: targets.length });
+    metrics.increment(`captures_${reason}`, targets.length);
+
+    const results = await scheduler.runCycle(targets, (target) => captureFrame(target, trace));
+
+    for (const r of results) {
+      if (r.ok) {
+        captured.push({ target: targets.find((t) => t.key === r.camera), frame: r.result });
+      } else {
+        failures.push({ camera: r.camera, error: r.error.message });
+        logger.error("Error during capture", {
+          camera: r.camera,
+          error: r.error.message,
+        });
+        logger.event("capture_error", "Capture or detection failed", {
+          camera: r.camera,
+          error: r.error.message,
+        });
+      }
+    }
+
+    // One dead camera should not force a client recycle while the others
+    // are still capturing fine.
+    if (captured.length === 0) {
+      throw new Error(`All ${results.length} camera captures failed`);
+    }
     consecutiveFailures = 0;
   } catch (error) {
+    if (failures.length === 0) failures.push({ error: error.message });
     consecutiveFailures++;
-    logger.error("Error during capture/detection", {
+    logger.error("Error during capture", {
       error: error.message,
       consecutiveFailures,
     });
     logger.event("capture_error", "Capture or detection failed", {
       error: error.message,
     });
-  } finally {
-    // Disconnect from MQTT
-    await disconnect(mqttClient);
   }
 
-  logger.info("Video capture completed successfully");
-}
-
-/**
- * Parse duration string like "60s", "5m" to milliseconds
- */
-function parseDuration(str) {
-  const match = str.match(/^(\d+)(s|m|h)?$/);
-  if (!match) return null;
-
-  const value = parseInt(match[1]);
-  const unit = match[2] || 's';
+  const detections = Promise.all(
+    captured.map(({ target, frame }) =>
+      detectAndPublish(target, frame, { reason, triggeredAt }, trace).then(
+        (result) => {
+          // Log success event for healthcheck
+          logger.event("capture_success", "Capture and detection complete", {
+            camera: target.key,
+            packageDetected: result.packageDetected,
+            stale: result.stale || undefined,
+          });
+          return true;
+        },
+        (error) => {
+          if (error.superseded) {
+            logger.info("Frame dropped for a newer one", { camera: target.key });
+            return false;
+          }
+          logger.error("Error during detection", { camera: target.key, error: error.message });
+          logger.event("capture_error", "Capture or detection failed", {
+            camera: target.key,
+            error: error.message,
+          });
+          return false;
+        }
+      )
+    )
+  ).then((outcomes) => {
+    const succeeded = outcomes.filter(Boolean).length;
+    if (succeeded > 0) {
+      recordCycle();
+    }
+    trace.end({ captured: captured.length, succeeded });
+  });
 
-  switch (unit) {
-    case 's': return value * 1000;
-    case 'm': return value * 60 * 1000;
-    case 'h': return value * 60 * 60 * 1000;
-    default: return null;
+  // Only the capture stage; detection results are logged as they arrive
+  if (captured.length > 0) {
+    logger.info("Video capture completed successfully", {
+      captured: captured.length,
+      failed: failures.length || undefined,
+    });
+  } else {
+    logger.error("Video capture failed", { failures });
   }
+  return { detections };
 }
 
 async function main() {
-  // Parse --loop argument
+  // Eufy cameras stream h264 unless they report otherwise; other codecs
+  // get a warm worker after their first capture.
+  ffmpegPool.prewarm("h264");
+
+  // Parse --loop and --events arguments. With --events, motion/person/ring
+  // events trigger captures and --loop becomes a slow heartbeat. With
+  // --keep-warm, station P2P sessions stay open between captures.
   const loopIndex = process.argv.indexOf('--loop');
+  const eventsMode = process.argv.includes('--events');
+  const keepWarm = process.argv.includes('--keep-warm');
 
-  if (loopIndex !== -1 && process.argv[loopIndex + 1]) {
-    const intervalMs = parseDuration(process.argv[loopIndex + 1]);
+  if (eventsMode || (loopIndex !== -1 && process.argv[loopIndex + 1])) {
+    const intervalMs =
+      loopIndex !== -1 && process.argv[loopIndex + 1]
+        ? parseDuration(process.argv[loopIndex + 1])
+        : MAX_LOOP_INTERVAL_MS;
 
     if (!intervalMs) {
       logger.error("Invalid --loop duration. Use format: 60s, 5m, 1h");
       process.exit(1);
     }
+    if (intervalMs > MAX_LOOP_INTERVAL_MS) {
+      logger.error(
+        `--loop ${process.argv[loopIndex + 1]} would let the healthcheck go stale: use at most ` +
+          `${MAX_LOOP_INTERVAL_MS / 1000}s, or raise HEALTHCHECK_WINDOW (now ${HEALTHCHECK_WINDOW})`
+      );
+      process.exit(1);
+    }
+
+    const policyIndex = process.argv.indexOf('--policy');
+    const policyName = policyIndex !== -1 ? process.argv[policyIndex + 1] : "fixed";
+    let policy;
+    try {
+      policy = createPolicy(policyName, { baseIntervalMs: intervalMs, maxIntervalMs: MAX_LOOP_INTERVAL_MS });
+    } catch (error) {
+      logger.error(error.message);
+      process.exit(1);
+    }
 
-    logger.info(`Running in loop mode, interval: ${intervalMs / 1000}s`);
+    eventTriggersEnabled = eventsMode;
+    logger.info(`Running in loop mode, interval: ${intervalMs / 1000}s`, {
+      eventTriggers: eventsMode,
+      policy: policy.name,
+      keepWarm,
+    });
+
+    if (keepWarm) {
+      stationSessions.keepWarm(() => currentTargets.map((t) => t.stationSerial));
+    }
 
     while (true) {
+      // Only waits for the capture stage; detection for this cycle finishes
+      // on the detection pool while the loop sleeps or captures again
       await runOnce();
-      const sleepMs = authError ? AUTH_BACKOFF_MS : intervalMs;
+      metrics.flush();
+
       if (authError) {
+        const sleepMs = AUTH_BACKOFF_MS;
         logger.warn(
           `Auth failure; backing off ${sleepMs / 1000}s before next login attempt`,
           { error: authError.message }
         );
+        logger.info(`Waiting ${sleepMs / 1000}s until next capture...`);
+        await new Promise((resolve) => setTimeout(resolve, sleepMs));
+        continue;
+      }
+
+      // Sleep until the policy's delay has elapsed. Motion wakes the loop
+      // early so the policy can shorten the wait.
+      const sleepStartedAt = Date.now();
+      let sleepMs = policy.nextDelay({ now: sleepStartedAt, ...scheduleState });
+      logger.info(`Waiting ${Math.round(sleepMs / 1000)}s until next capture...`);
+      while (Date.now() - sleepStartedAt < sleepMs) {
+        await new Promise((resolve) => {
+          const timer = setTimeout(resolve, sleepMs - (Date.now() - sleepStartedAt));
+          wakeLoop = () => {
+            clearTimeout(timer);
+            resolve();
+          };
+        });
+        wakeLoop = null;
+        const nextMs = policy.nextDelay({ now: Date.now(), ...scheduleState });
+        if (Date.now() - sleepStartedAt + nextMs < sleepMs) {
+          sleepMs = Date.now() - sleepStartedAt + nextMs;
+          logger.info(`Activity detected; next capture in ${Math.round(nextMs / 1000)}s`);
+        }
       }
-      logger.info(`Waiting ${sleepMs / 1000}s until next capture...`);
-      await new Promise((resolve) => setTimeout(resolve, sleepMs));
     }
   } else {
-    await runOnce();
+    const { detections } = await runOnce();
+    await detections;
+    await annotationQueue.idle();
+    metrics.flush();
+    ffmpegPool.close();
+    await detectionPool.close();
+    await mqttPublisher.close();
+    // A one-shot run (e.g. from cron) is the only chance to expire files, so
+    // the startup listing, an expiry pass and the snapshot store's prune
+    // finish before exiting. Also when the capture was skipped for cooldown.
+    ensureDirectories();
+    await retentionScan;
+    await retention.expire();
+    await snapshotStore?.prune();
     process.exit(0);
   }
 }
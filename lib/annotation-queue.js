@@ -0,0 +1,101 @@
+import fs from "fs";
+import { logger } from "./logger.js";
+import { loadFrame, addTextOverlay, annotatedPathFor } from "./image-processor.js";
+
+/**
+ * Renders annotated images in the background, after the result has been
+ * published. Positive results are always annotated (Slack sends that image);
+ * other frames one in sampleEvery per camera.
+ *
+ * When the queue is full, the oldest waiting negative is dropped first.
+ *
+ * @param {object} options
+ * @param {number} options.concurrency - Images rendered at once
+ * @param {number} options.queueLimit - Images waiting before dropping
+ * @param {number} options.sampleEvery - Annotate 1 in N frames that are not new positives
+ * @param {object} options.metrics - Registry from createMetrics()
+ * @param {function(string): void} [options.onRendered] - Called with the path of each image written
+ */
+export function createAnnotationQueue({ concurrency, queueLimit, sampleEvery, metrics, onRendered = () => {} }) {
+  const queue = []; // [{cameraKey, framePath, jpeg, result, outputPath}]
+  const sinceSampled = new Map(); // camera key -> frames skipped since the last annotated one
+  let running = 0;
+  let idleWaiters = [];
+
+  function sampled(cameraKey, result, reused) {
+    if (result.package_detected && !reused) return true;
+    const skipped = (sinceSampled.get(cameraKey) || 0) + 1;
+    if (skipped >= sampleEvery) {
+      sinceSampled.set(cameraKey, 0);
+      return true;
+    }
+    sinceSampled.set(cameraKey, skipped);
+    return false;
+  }
+
+  async function render(job) {
+    const startedAt = Date.now();
+    // Written under another name and renamed, so a reader never sees half an image
+    const partialPath = job.outputPath.replace(/\.jpg$/, ".partial.jpg");
+    try {
+      const frame = await loadFrame(job.framePath, job.jpeg);
+      await addTextOverlay(frame, job.result, partialPath);
+      await fs.promises.rename(partialPath, job.outputPath);
+      onRendered(job.outputPath);
+      metrics.observe("annotation_ms", Date.now() - startedAt);
+      logger.info(`Created annotated image: ${job.outputPath}`);
+    } catch (error) {
+      logger.warn(`Could not add text overlay: ${error.message}`, { camera: job.cameraKey });
+    }
+  }
+
+  function drain() {
+    while (running < concurrency && queue.length > 0) {
+      const job = queue.shift();
+      running++;
+      render(job).finally(() => {
+        running--;
+        drain();
+      });
+    }
+    if (running === 0 && queue.length === 0) {
+      for (const resolve of idleWaiters) resolve();
+      idleWaiters = [];
+    }
+  }
+
+  /**
+   * Queue a frame for annotation, if sampled
+   * @param {{cameraKey: string, framePath: string, jpeg?: Buffer, result: object, reused?: boolean,
+   *   outputPath?: string}} frame - outputPath defaults to annotatedPathFor(framePath)
+   * @returns {string|null} - Where the annotated image will be written, or null if not sampled
+   */
+  function submit({ cameraKey, framePath, jpeg = null, result, reused = false, outputPath = null }) {
+    if (!sampled(cameraKey, result, reused)) {
+      metrics.increment("annotations_skipped");
+      return null;
+    }
+
+    if (queue.length >= queueLimit) {
+      const negative = queue.findIndex((job) => !job.result.package_detected);
+      const [dropped] = queue.splice(negative !== -1 ? negative : 0, 1);
+      metrics.increment("annotations_dropped");
+      logger.debug("Annotation queue full; dropped a frame", { frame: dropped.framePath });
+    }
+
+    if (!outputPath) outputPath = annotatedPathFor(framePath);
+    queue.push({ cameraKey, framePath, jpeg, result, outputPath });
+    drain();
+    return outputPath;
+  }
+
+  /**
+   * @returns {Promise<void>} - Resolves once every queued image is rendered
+   */
+  function idle() {
+    if (running === 0 && queue.length === 0) return Promise.resolve();
+    return new Promise((resolve) => idleWaiters.push(resolve));
+  }
+
+  return { submit, idle, pending: () => queue.length + running };
+}
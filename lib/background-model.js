@@ -0,0 +1,247 @@
+import fs from "fs";
+import { logger } from "./logger.js";
+import { roiThumbnail } from "./image-processor.js";
+
+// Running background of the doorstep crop, per camera. Each frame's
+// thumbnail (see roiThumbnail()) is compared against it to find foreground
+// blobs; the LLM is only asked again when a new blob has stayed put (e.g. a
+// package was set down) or a blob seen at the last LLM call is gone (it was
+// picked up). Otherwise the last result is reused.
+export const BACKGROUND_WIDTH = 128;
+
+const MIN_BLOB_OVERLAP = 0.3; // Intersection-over-union for "the same blob"
+
+/**
+ * Label the 8-connected foreground regions of a mask
+ * @param {Uint8Array} mask - 1 for foreground
+ * @param {number} width
+ * @param {number} height
+ * @param {number} minPixels - Smaller regions are ignored as noise
+ * @returns {Array<{x: number, y: number, w: number, h: number, pixels: number}>}
+ */
+export function findBlobs(mask, width, height, minPixels) {
+  const seen = new Uint8Array(mask.length);
+  const stack = new Int32Array(mask.length);
+  const blobs = [];
+
+  for (let start = 0; start < mask.length; start++) {
+    if (!mask[start] || seen[start]) continue;
+
+    let top = 0;
+    stack[top++] = start;
+    seen[start] = 1;
+    let pixels = 0;
+    let minX = width, minY = height, maxX = 0, maxY = 0;
+
+    while (top > 0) {
+      const i = stack[--top];
+      const x = i % width;
+      const y = (i - x) / width;
+      pixels++;
+      if (x < minX) minX = x;
+      if (x > maxX) maxX = x;
+      if (y < minY) minY = y;
+      if (y > maxY) maxY = y;
+
+      for (let dy = -1; dy <= 1; dy++) {
+        const ny = y + dy;
+        if (ny < 0 || ny >= height) continue;
+        for (let dx = -1; dx <= 1; dx++) {
+          const nx = x + dx;
+          if (nx < 0 || nx >= width) continue;
+          const j = ny * width + nx;
+          if (mask[j] && !seen[j]) {
+            seen[j] = 1;
+            stack[top++] = j;
+          }
+        }
+      }
+    }
+
+    if (pixels >= minPixels) {
+      blobs.push({ x: minX, y: minY, w: maxX - minX + 1, h: maxY - minY + 1, pixels });
+    }
+  }
+  return blobs;
+}
+
+function overlap(a, b) {
+  const w = Math.min(a.x + a.w, b.x + b.w) - Math.max(a.x, b.x);
+  const h = Math.min(a.y + a.h, b.y + b.h) - Math.max(a.y, b.y);
+  if (w <= 0 || h <= 0) return 0;
+  const intersection = w * h;
+  return intersection / (a.w * a.h + b.w * b.h - intersection);
+}
+
+function matches(blob, others) {
+  return others.some((other) => overlap(blob, other) >= MIN_BLOB_OVERLAP);
+}
+
+/**
+ * @param {object} options
+ * @param {string} options.stateFile - Where the model is persisted between restarts
+ * @param {number} options.learningRate - Per-frame weight of the new frame in the background (0-1)
+ * @param {number} options.pixelDelta - Difference from the background (0-255) that counts as foreground
+ * @param {number} options.minBlobFraction - Smallest blob, as a share of the crop
+ * @param {number} options.stationaryFrames - Frames a new blob must stay put before the LLM is asked
+ * @param {number} options.maxReuseMs - Always re-detect after this long
+ * @param {object} options.metrics - Registry from createMetrics()
+ */
+export function createBackgroundModel({
+  stateFile,
+  learningRate,
+  pixelDelta,
+  minBlobFraction,
+  stationaryFrames,
+  maxReuseMs,
+  metrics,
+}) {
+  // camera key -> {width, height, background: Float32Array, known: blobs at the last LLM call,
+  //   candidates: [{blob, frames}], detection, at}
+  const models = load();
+
+  function load() {
+    const loaded = new Map();
+    try {
+      if (!fs.existsSync(stateFile)) return loaded;
+      const saved = JSON.parse(fs.readFileSync(stateFile, "utf-8"));
+      for (const [key, m] of Object.entries(saved)) {
+        const background = Float32Array.from(Buffer.from(m.background, "base64"));
+        if (background.length !== m.width * m.height) continue;
+        loaded.set(key, { ...m, background });
+      }
+      logger.info("Loaded background model", { cameras: [...loaded.keys()] });
+    } catch (error) {
+      logger.warn(`Could not load background model, starting fresh: ${error.message}`);
+    }
+    return loaded;
+  }
+
+  // About 1 byte per crop pixel per camera, rewritten after every frame
+  function save() {
+    const out = {};
+    for (const [key, m] of models) {
+      out[key] = {
+        width: m.width,
+        height: m.height,
+        background: Buffer.from(Uint8Array.from(m.background, Math.round)).toString("base64"),
+        known: m.known,
+        candidates: m.candidates,
+        detection: m.detection,
+        at: m.at,
+      };
+    }
+    try {
+      fs.writeFileSync(`${stateFile}.tmp`, JSON.stringify(out));
+      fs.renameSync(`${stateFile}.tmp`, stateFile);
+    } catch (error) {
+      logger.warn(`Could not save background model: ${error.message}`);
+    }
+  }
+
+  /**
+   * Compare a frame against the camera's background, then fold it in
+   * @param {string} cameraKey
+   * @param {object} thumbnail - From thumbnail()
+   * @returns {{reuse: object|null, sample: object[], foregroundFraction?: number,
+   *   newBlobs?: number, goneBlobs?: number}} - reuse is the previous detection when
+   *   nothing new is on the doorstep; sample is the frame's blobs, for remember()
+   */
+  function check(cameraKey, thumbnail) {
+    const { width, height, pixels } = thumbnail;
+    const m = models.get(cameraKey);
+    if (!m || m.width !== width || m.height !== height) {
+      models.set(cameraKey, {
+        width,
+        height,
+        background: Float32Array.from(pixels),
+        known: [],
+        candidates: [],
+        detection: null,
+        at: 0,
+      });
+      // The first frame is the background, so nothing in it is foreground
+      return { reuse: null, sample: [] };
+    }
+
+    // Remove the mean brightness offset so daylight and clouds don't show up as foreground
+    const n = pixels.length;
+    const background = m.background;
+    let offset = 0;
+    for (let i = 0; i < n; i++) offset += pixels[i] - background[i];
+    offset /= n;
+
+    const mask = new Uint8Array(n);
+    let foreground = 0;
+    for (let i = 0; i < n; i++) {
+      if (Math.abs(pixels[i] - background[i] - offset) > pixelDelta) {
+        mask[i] = 1;
+        foreground++;
+      }
+    }
+    const blobs = findBlobs(mask, width, height, Math.max(1, Math.round(minBlobFraction * n)));
+
+    // A blob counts once it is at the same place for stationaryFrames frames;
+    // people walking past rarely are
+    const candidates = blobs
+      .filter((blob) => !matches(blob, m.known))
+      .map((blob) => {
+        const previous = m.candidates.find((c) => overlap(blob, c.blob) >= MIN_BLOB_OVERLAP);
+        return { blob, frames: previous ? previous.frames + 1 : 1 };
+      });
+    const newBlobs = candidates.filter((c) => c.frames >= stationaryFrames).length;
+    const goneBlobs = m.known.filter((blob) => !matches(blob, blobs)).length;
+
+    // Foreground adapts slowly, so a package left for a long time becomes
+    // background; its blob then reads as gone and is checked once more.
+    const foregroundRate = learningRate / 10;
+    for (let i = 0; i < n; i++) {
+      const rate = mask[i] ? foregroundRate : learningRate;
+      background[i] += rate * (pixels[i] - background[i]);
+    }
+    m.candidates = candidates;
+
+    const foregroundFraction = foreground / n;
+    metrics.observe("background_foreground_x1000", Math.round(foregroundFraction * 1000));
+    const fresh = m.detection && Date.now() - m.at <= maxReuseMs;
+    const unchanged = fresh && newBlobs === 0 && goneBlobs === 0;
+    metrics.increment(unchanged ? "background_reused" : "background_escalated");
+    logger.debug("Background model", {
+      camera: cameraKey,
+      foregroundFraction,
+      blobs: blobs.length,
+      newBlobs,
+      goneBlobs,
+      unchanged,
+    });
+    save();
+
+    return {
+      reuse: unchanged ? m.detection : null,
+      sample: blobs,
+      foregroundFraction,
+      newBlobs,
+      goneBlobs,
+    };
+  }
+
+  /**
+   * Record the LLM result for a frame; its blobs become the known ones. Takes
+   * the check() result for that frame: with detections in flight, later
+   * frames may have been checked since.
+   * @param {string} cameraKey
+   * @param {{sample: object[]}} checked - check() result for the detected frame
+   * @param {object} detection
+   */
+  function remember(cameraKey, checked, detection) {
+    const m = models.get(cameraKey);
+    if (!m) return;
+    m.known = checked.sample;
+    m.candidates = [];
+    m.detection = detection;
+    m.at = Date.now();
+    save();
+  }
+
+  return { thumbnail: (input, roi) => roiThumbnail(input, BACKGROUND_WIDTH, roi), check, remember };
+}
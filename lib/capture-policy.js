@@ -0,0 +1,128 @@
+// Capture interval policies. A policy decides how long the capture loop
+// waits before the next cycle, given what recent cycles saw. Policies are
+// pure functions of their input so scripts/simulate-schedule.js can replay
+// historical detection logs through them.
+
+const MINUTE_MS = 60 * 1000;
+
+const ADAPTIVE_DEFAULTS = {
+  fastIntervalMs: 30 * 1000, // right after motion or a package_exists transition
+  fastWindowMs: 10 * MINUTE_MS, // how long "right after" lasts
+  nightStartHour: 23,
+  nightEndHour: 6,
+  nightMultiplier: 4,
+  streakBeforeBackoff: 3, // identical results before backing off
+  maxBackoffFactor: 4,
+  // Worst-case latency bound, even at night. Below the server's default
+  // 10 minute healthcheck window; capture.js passes its own limit.
+  maxIntervalMs: 8 * MINUTE_MS,
+  jitterRatio: 0.1,
+  timeZone: process.env.CAPTURE_TIMEZONE || "America/Los_Angeles",
+};
+
+/**
+ * Hour of day (0-23) of a timestamp in the given time zone
+ * @param {number} ms
+ * @param {string} timeZone
+ */
+function hourOfDay(ms, timeZone) {
+  const hour = new Date(ms).toLocaleString("en-US", {
+    timeZone,
+    hour: "numeric",
+    hourCycle: "h23",
+  });
+  return parseInt(hour);
+}
+
+/**
+ * Number of trailing results with the same package_detected value
+ * @param {Array<{detected: boolean}>} history - Oldest first
+ */
+function identicalStreak(history) {
+  if (history.length === 0) return 0;
+  const last = history[history.length - 1].detected;
+  let streak = 0;
+  for (let i = history.length - 1; i >= 0 && history[i].detected === last; i--) {
+    streak++;
+  }
+  return streak;
+}
+
+/**
+ * Fixed interval, the historical --loop behaviour
+ */
+function createFixedPolicy({ baseIntervalMs }) {
+  return {
+    name: "fixed",
+    nextDelay() {
+      return baseIntervalMs;
+    },
+  };
+}
+
+/**
+ * Adaptive interval: fast after activity, slow overnight, backing off while
+ * results repeat, with jitter so instances do not synchronize.
+ */
+function createAdaptivePolicy({ baseIntervalMs, random = Math.random, ...overrides }) {
+  const opts = { ...ADAPTIVE_DEFAULTS, ...overrides };
+
+  return {
+    name: "adaptive",
+    /**
+     * @param {object} state
+     * @param {number} state.now
+     * @param {Array<{at: number, detected: boolean}>} state.history - Recent results, oldest first
+     * @param {number|null} state.lastMotionAt
+     * @param {number|null} state.lastTransitionAt
+     * @returns {number} - Delay in ms
+     */
+    nextDelay({ now, history, lastMotionAt, lastTransitionAt }) {
+      const lastActivity = Math.max(lastMotionAt || 0, lastTransitionAt || 0);
+
+      let delay;
+      if (now - lastActivity < opts.fastWindowMs) {
+        delay = Math.min(opts.fastIntervalMs, baseIntervalMs);
+      } else {
+        const streak = identicalStreak(history);
+        const backoff = Math.min(
+          2 ** Math.max(0, streak - opts.streakBeforeBackoff),
+          opts.maxBackoffFactor
+        );
+        delay = baseIntervalMs * backoff;
+
+        const hour = hourOfDay(now, opts.timeZone);
+        const night =
+          opts.nightStartHour > opts.nightEndHour
+            ? hour >= opts.nightStartHour || hour < opts.nightEndHour
+            : hour >= opts.nightStartHour && hour < opts.nightEndHour;
+        if (night) {
+          delay *= opts.nightMultiplier;
+        }
+        // Leaves room for jitter, so even the longest delay stays under the bound
+        delay = Math.min(delay, opts.maxIntervalMs / (1 + opts.jitterRatio));
+      }
+
+      const jitter = 1 + (random() * 2 - 1) * opts.jitterRatio;
+      return Math.round(delay * jitter);
+    },
+  };
+}
+
+export const POLICIES = {
+  fixed: createFixedPolicy,
+  adaptive: createAdaptivePolicy,
+};
+
+/**
+ * Create a capture interval policy by name
+ * @param {string} name - Key of POLICIES
+ * @param {object} options - {baseIntervalMs, ...policy-specific overrides}
+ */
+export function createPolicy(name, options) {
+  const factory = POLICIES[name];
+  if (!factory) {
+    throw new Error(`Unknown capture policy "${name}". Use one of: ${Object.keys(POLICIES).join(", ")}`);
+  }
+  return factory(options);
+}
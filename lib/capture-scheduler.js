@@ -0,0 +1,124 @@
+import { logger } from "./logger.js";
+
+// Eufy P2P sessions are per station, and a station only serves one
+// livestream at a time reliably. Cameras on different stations can stream
+// in parallel.
+const DEFAULT_MAX_PER_STATION = 1;
+
+/**
+ * Create a capture scheduler that runs per-camera capture jobs with a
+ * per-station concurrency limit.
+ *
+ * Jobs are dispatched in FIFO order, skipping over cameras whose station is
+ * saturated, so every camera gets its turn. A camera that is already queued
+ * or running is not queued twice; callers share the pending job instead.
+ *
+ * @param {object} options
+ * @param {number} options.maxPerStation - Max concurrent jobs per station
+ * @returns {{schedule: Function, runCycle: Function, stats: Function}}
+ */
+export function createCaptureScheduler({ maxPerStation = DEFAULT_MAX_PER_STATION } = {}) {
+  const pending = []; // [{ camera, task, resolve, reject, promise }]
+  const running = new Map(); // cameraKey -> job
+  const activePerStation = new Map(); // stationSerial -> count
+  let cycleCount = 0;
+
+  function stationSlots(stationSerial) {
+    return maxPerStation - (activePerStation.get(stationSerial) || 0);
+  }
+
+  function drain() {
+    for (let i = 0; i < pending.length; ) {
+      const job = pending[i];
+      const station = job.camera.stationSerial;
+
+      if (stationSlots(station) <= 0) {
+        i++;
+        continue;
+      }
+
+      pending.splice(i, 1);
+      running.set(job.camera.key, job);
+      activePerStation.set(station, (activePerStation.get(station) || 0) + 1);
+      start(job);
+    }
+  }
+
+  function start(job) {
+    const station = job.camera.stationSerial;
+    const startedAt = Date.now();
+
+    Promise.resolve()
+      .then(() => job.task(job.camera))
+      .then(
+        (result) => job.resolve(result),
+        (error) => job.reject(error)
+      )
+      .finally(() => {
+        running.delete(job.camera.key);
+        activePerStation.set(station, activePerStation.get(station) - 1);
+        logger.debug("Capture job finished", {
+          camera: job.camera.key,
+          station,
+          durationMs: Date.now() - startedAt,
+        });
+        drain();
+      });
+  }
+
+  /**
+   * Queue a capture job for one camera
+   * @param {{key: string, stationSerial: string}} camera
+   * @param {(camera: object) => Promise<any>} task
+   * @returns {Promise<any>} - Resolves with the task's result
+   */
+  function schedule(camera, task) {
+    const existing =
+      running.get(camera.key) || pending.find((job) => job.camera.key === camera.key);
+    if (existing) {
+      logger.debug("Capture already queued for camera", { camera: camera.key });
+      return existing.promise;
+    }
+
+    const job = { camera, task };
+    job.promise = new Promise((resolve, reject) => {
+      job.resolve = resolve;
+      job.reject = reject;
+    });
+    pending.push(job);
+    drain();
+    return job.promise;
+  }
+
+  /**
+   * Run one capture cycle across all cameras. The starting camera rotates
+   * each cycle so no camera is permanently last in line for its station.
+   * @param {object[]} cameras
+   * @param {(camera: object) => Promise<any>} task
+   * @returns {Promise<Array<{camera: string, ok: boolean, result?: any, error?: Error}>>}
+   */
+  async function runCycle(cameras, task) {
+    const offset = cameras.length > 0 ? cycleCount % cameras.length : 0;
+    cycleCount++;
+    const ordered = [...cameras.slice(offset), ...cameras.slice(0, offset)];
+
+    const settled = await Promise.allSettled(ordered.map((camera) => schedule(camera, task)));
+
+    return settled.map((outcome, i) => ({
+      camera: ordered[i].key,
+      ok: outcome.status === "fulfilled",
+      result: outcome.value,
+      error: outcome.reason,
+    }));
+  }
+
+  function stats() {
+    return {
+      pending: pending.length,
+      running: running.size,
+      cycles: cycleCount,
+    };
+  }
+
+  return { schedule, runCycle, stats };
+}
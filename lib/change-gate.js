@@ -0,0 +1,83 @@
+import { logger } from "./logger.js";
+import { roiThumbnail } from "./image-processor.js";
+
+// Skip the LLM when the doorstep looks the same as the last frame that was
+// sent for detection, and reuse that frame's result instead. Frames are
+// compared as small grayscale thumbnails of the crop region (see
+// roiThumbnail()); a uniform brightness shift is removed first so slow
+// lighting changes do not count as change.
+export const THUMBNAIL_WIDTH = 64;
+
+/**
+ * Compare two thumbnails of the same size
+ * @param {{pixels: Uint8Array}} a
+ * @param {{pixels: Uint8Array}} b
+ * @param {number} pixelDelta - Per-pixel difference (0-255) that counts as changed
+ * @returns {{meanDiff: number, changedFraction: number}}
+ */
+export function compareThumbnails(a, b, pixelDelta) {
+  const pa = a.pixels;
+  const pb = b.pixels;
+  const n = pa.length;
+
+  let offset = 0;
+  for (let i = 0; i < n; i++) offset += pa[i] - pb[i];
+  offset /= n;
+
+  let sum = 0;
+  let changed = 0;
+  for (let i = 0; i < n; i++) {
+    const d = Math.abs(pa[i] - pb[i] - offset);
+    sum += d;
+    if (d > pixelDelta) changed++;
+  }
+  return { meanDiff: sum / n, changedFraction: changed / n };
+}
+
+/**
+ * @param {object} options
+ * @param {number} options.pixelDelta - See compareThumbnails()
+ * @param {number} options.maxMeanDiff - Above this the scene changed
+ * @param {number} options.maxChangedFraction - Above this the scene changed
+ * @param {number} options.maxReuseMs - Always re-detect after this long, so drift can't accumulate
+ * @param {object} options.metrics - Registry from createMetrics()
+ */
+export function createChangeGate({ pixelDelta, maxMeanDiff, maxChangedFraction, maxReuseMs, metrics }) {
+  const lastSent = new Map(); // camera key -> {thumbnail, detection, at}
+
+  /**
+   * @param {string} cameraKey
+   * @param {object} thumbnail - From thumbnail()
+   * @returns {{reuse: object|null, sample: object, meanDiff?: number, changedFraction?: number}} -
+   *   reuse is the previous detection when the scene is unchanged; sample is for remember()
+   */
+  function check(cameraKey, thumbnail) {
+    const previous = lastSent.get(cameraKey);
+    if (!previous || previous.thumbnail.pixels.length !== thumbnail.pixels.length) {
+      return { reuse: null, sample: thumbnail };
+    }
+    if (Date.now() - previous.at > maxReuseMs) {
+      return { reuse: null, sample: thumbnail };
+    }
+
+    const { meanDiff, changedFraction } = compareThumbnails(thumbnail, previous.thumbnail, pixelDelta);
+    metrics.observe("change_gate_mean_diff_x100", Math.round(meanDiff * 100));
+    const unchanged = meanDiff <= maxMeanDiff && changedFraction <= maxChangedFraction;
+    metrics.increment(unchanged ? "change_gate_reused" : "change_gate_changed");
+    logger.debug("Change gate", { camera: cameraKey, meanDiff, changedFraction, unchanged });
+
+    return { reuse: unchanged ? previous.detection : null, sample: thumbnail, meanDiff, changedFraction };
+  }
+
+  /**
+   * Record the frame that was just sent for detection, and its result
+   * @param {string} cameraKey
+   * @param {{sample: object}} checked - check() result for that frame
+   * @param {object} detection
+   */
+  function remember(cameraKey, checked, detection) {
+    lastSent.set(cameraKey, { thumbnail: checked.sample, detection, at: Date.now() });
+  }
+
+  return { thumbnail: (input, roi) => roiThumbnail(input, THUMBNAIL_WIDTH, roi), check, remember };
+}
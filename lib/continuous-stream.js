@@ -0,0 +1,188 @@
+import { logger } from "./logger.js";
+import { spawnJpegDecoder } from "./ffmpeg-pool.js";
+import { findKeyframeOffset, codecFromMetadata } from "./h26x.js";
+import { createJpegSplitter } from "./jpeg-stream.js";
+import { createFrameRing } from "./frame-ring.js";
+
+// The Eufy livestream drops after ~25s. Rather than fight that, restart it
+// as soon as it stops and feed every session into one long-lived decoder.
+const RESTART_BACKOFF_MAX_MS = 30 * 1000;
+const START_TIMEOUT_MS = 15 * 1000; // start command sent but no stream yet
+const STALL_TIMEOUT_MS = 10 * 1000; // stream open but no video chunks
+
+/**
+ * Supervise a continuous livestream from one camera.
+ *
+ * @param {EufySecurity} eufy - Connected client
+ * @param {Device} device - Camera to stream from
+ * @param {object} options
+ * @param {number} options.ringSize - Decoded frames kept in memory
+ * @param {number} options.sampleIntervalS - Seconds between decoded frames
+ * @param {object} options.metrics - Registry from createMetrics()
+ * @param {(frame: object) => void} [options.onFrame] - Called for each decoded frame
+ * @returns {{start: Function, stop: Function, ring: object}}
+ */
+export function createContinuousStream(eufy, device, { ringSize, sampleIntervalS, metrics, onFrame }) {
+  const serial = device.getSerial();
+  const ring = createFrameRing(ringSize);
+  const splitter = createJpegSplitter((jpeg) => {
+    ring.push(jpeg);
+    metrics.increment("frames_decoded");
+    if (onFrame) onFrame(ring.latest());
+  });
+
+  let decoder = null;
+  let decoderCodec = null;
+  let synced = false; // decoder has been fed a keyframe since the last (re)start
+  let stopping = false;
+  let stoppedAt = null; // when the current outage began
+  let restartAttempt = 0;
+  let restartTimer = null;
+  let startWatchdog = null;
+  let stallWatchdog = null;
+
+  function ensureDecoder(codec) {
+    if (decoder && decoderCodec === codec) return;
+    if (decoder) {
+      logger.warn("Stream codec changed; replacing decoder", { from: decoderCodec, to: codec });
+      decoder.stdin.end();
+    }
+
+    decoderCodec = codec;
+    synced = false;
+    splitter.reset();
+    const proc = spawnJpegDecoder(codec, { sampleIntervalS });
+    decoder = proc;
+
+    proc.stdout.on("data", (data) => splitter.push(data));
+    proc.stderr.on("data", () => {}); // drain; ffmpeg logs progress here
+    proc.stdin.on("error", (err) => {
+      logger.debug("Decoder stdin error", { error: err.message });
+    });
+    proc.on("error", (err) => {
+      logger.error("FFmpeg process error", { error: err.message });
+    });
+    proc.on("close", (code) => {
+      if (decoder !== proc) return;
+      decoder = null;
+      if (!stopping) {
+        // Next chunk respawns it; the new decoder needs a keyframe first
+        logger.warn("Decoder exited unexpectedly", { code });
+        metrics.increment("decoder_restarts");
+      }
+    });
+  }
+
+  function armStallWatchdog() {
+    clearTimeout(stallWatchdog);
+    stallWatchdog = setTimeout(() => {
+      logger.warn(`No video for ${STALL_TIMEOUT_MS / 1000}s; restarting livestream`);
+      metrics.increment("stalls");
+      eufy.stopStationLivestream(serial).catch(() => {});
+      handleStop();
+    }, STALL_TIMEOUT_MS);
+  }
+
+  function onChunk(chunk, codec) {
+    armStallWatchdog();
+    ensureDecoder(codec);
+
+    if (!synced) {
+      const offset = findKeyframeOffset(chunk, codec);
+      if (offset === -1) {
+        metrics.increment("chunks_dropped_before_keyframe");
+        return;
+      }
+      chunk = chunk.subarray(offset);
+      synced = true;
+      if (stoppedAt !== null) {
+        const gapMs = Date.now() - stoppedAt;
+        metrics.observe("resync_gap_ms", gapMs);
+        logger.event("livestream_resynced", "Decoder re-synced on keyframe", { gapMs });
+        stoppedAt = null;
+      }
+    }
+
+    if (!decoder.stdin.destroyed) {
+      decoder.stdin.write(chunk);
+    }
+  }
+
+  function handleStart(station, startedDevice, metadata, videoStream) {
+    if (stopping || startedDevice.getSerial() !== serial) return;
+
+    clearTimeout(startWatchdog);
+    restartAttempt = 0;
+    const codec = codecFromMetadata(metadata);
+    logger.info("Livestream started", { device: device.getName(), codec });
+    if (stoppedAt !== null) {
+      metrics.observe("restart_gap_ms", Date.now() - stoppedAt);
+    }
+
+    // A new session starts mid-GOP from the decoder's point of view
+    synced = false;
+    videoStream.on("data", (chunk) => onChunk(chunk, codec));
+    armStallWatchdog();
+  }
+
+  function handleStop(station, stoppedDevice) {
+    if (stopping || (stoppedDevice && stoppedDevice.getSerial() !== serial)) return;
+    if (stoppedAt !== null && restartTimer) return; // already restarting
+
+    clearTimeout(stallWatchdog);
+    if (stoppedAt === null) stoppedAt = Date.now();
+    metrics.increment("restarts");
+    logger.event("livestream_restart", "Livestream stopped; restarting", {
+      device: device.getName(),
+    });
+    scheduleRestart(0);
+  }
+
+  function scheduleRestart(delayMs) {
+    clearTimeout(restartTimer);
+    clearTimeout(startWatchdog);
+    restartTimer = setTimeout(async () => {
+      restartTimer = null;
+      if (stopping) return;
+      try {
+        await eufy.startStationLivestream(serial);
+      } catch (error) {
+        logger.warn("Livestream restart failed", { error: error.message });
+      }
+      // Retry with backoff if no stream shows up
+      clearTimeout(startWatchdog);
+      startWatchdog = setTimeout(() => {
+        restartAttempt++;
+        const backoff = Math.min(1000 * 2 ** restartAttempt, RESTART_BACKOFF_MAX_MS);
+        logger.warn(`Livestream did not start; retrying in ${backoff / 1000}s`, { restartAttempt });
+        scheduleRestart(backoff);
+      }, START_TIMEOUT_MS);
+    }, delayMs);
+  }
+
+  async function start() {
+    eufy.on("station livestream start", handleStart);
+    eufy.on("station livestream stop", handleStop);
+    stoppedAt = Date.now(); // measure cold start like any other gap
+    scheduleRestart(0);
+  }
+
+  async function stop() {
+    stopping = true;
+    clearTimeout(restartTimer);
+    clearTimeout(startWatchdog);
+    clearTimeout(stallWatchdog);
+    eufy.removeListener("station livestream start", handleStart);
+    eufy.removeListener("station livestream stop", handleStop);
+    try {
+      await eufy.stopStationLivestream(serial);
+    } catch {
+      // Ignore errors during shutdown
+    }
+    if (decoder && !decoder.stdin.destroyed) {
+      decoder.stdin.end();
+    }
+  }
+
+  return { start, stop, ring };
+}
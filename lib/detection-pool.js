@@ -0,0 +1,127 @@
+import { Worker } from "worker_threads";
+import { logger } from "./logger.js";
+
+const WORKER_URL = new URL("./detection-worker.js", import.meta.url);
+
+/**
+ * Pool of worker threads running package detection, fed from a bounded
+ * queue so slow LLM calls never hold up capturing.
+ *
+ * When the queue is full, the oldest waiting frame is dropped, preferring
+ * one from the same camera: a newer frame supersedes it.
+ *
+ * @param {object} options
+ * @param {number} options.size - Worker threads
+ * @param {number} options.queueLimit - Frames waiting for a worker before dropping
+ * @param {object} options.metrics - Registry from createMetrics()
+ */
+export function createDetectionPool({ size, queueLimit, metrics }) {
+  const workers = [];
+  const queue = []; // [{job, resolve, reject, queuedAt}]
+  let nextJobId = 1;
+  let closed = false;
+
+  function spawnWorker() {
+    const worker = new Worker(WORKER_URL);
+    const slot = { worker, current: null };
+
+    worker.on("message", (message) => {
+      const job = slot.current;
+      slot.current = null;
+      if (job && job.id === message.id) {
+        if (message.error) {
+          const error = new Error(message.error);
+          error.spans = message.spans;
+          job.reject(error);
+        } else {
+          job.resolve({ ...message, queueWaitMs: job.startedAt - job.queuedAt });
+        }
+      }
+      dispatch();
+    });
+    worker.on("error", (err) => {
+      logger.error("Detection worker error", { error: err.message });
+    });
+    worker.on("exit", (code) => {
+      workers.splice(workers.indexOf(slot), 1);
+      if (slot.current) {
+        slot.current.reject(new Error(`Detection worker exited (code ${code})`));
+        slot.current = null;
+      }
+      if (!closed) {
+        logger.warn("Detection worker exited; replacing it", { code });
+        spawnWorker();
+        dispatch();
+      }
+    });
+
+    workers.push(slot);
+  }
+
+  function dispatch() {
+    for (const slot of workers) {
+      if (queue.length === 0) return;
+      if (slot.current) continue;
+      const job = queue.shift();
+      job.startedAt = Date.now();
+      slot.current = job;
+      metrics.observe("detection_queue_wait_ms", job.startedAt - job.queuedAt);
+      slot.worker.postMessage({ id: job.id, framePath: job.framePath, jpeg: job.jpeg, roi: job.roi });
+    }
+  }
+
+  /**
+   * Queue a frame for detection
+   * @param {{cameraKey: string, framePath: string, jpeg?: Buffer, roi?: Array}} frame - jpeg is
+   *   the file's contents, if still in memory; the worker reads framePath otherwise. roi is
+   *   the camera's doorstep polygon, if configured
+   * @returns {Promise<{result: object, spans: object[], queueWaitMs: number}>} - Rejects with
+   *   error.superseded if dropped
+   */
+  function submit({ cameraKey, framePath, jpeg = null, roi = null }) {
+    return new Promise((resolve, reject) => {
+      if (closed) {
+        reject(new Error("Detection pool closed"));
+        return;
+      }
+
+      if (queue.length >= queueLimit) {
+        const sameCamera = queue.findIndex((j) => j.cameraKey === cameraKey);
+        const [dropped] = queue.splice(sameCamera !== -1 ? sameCamera : 0, 1);
+        const error = new Error(`Frame superseded while waiting for detection (${dropped.framePath})`);
+        error.superseded = true;
+        metrics.increment("detection_frames_dropped");
+        dropped.reject(error);
+      }
+
+      queue.push({
+        id: nextJobId++,
+        cameraKey,
+        framePath,
+        jpeg,
+        roi,
+        resolve,
+        reject,
+        queuedAt: Date.now(),
+      });
+      dispatch();
+    });
+  }
+
+  /**
+   * Stop all workers; frames still waiting are rejected
+   */
+  async function close() {
+    closed = true;
+    for (const job of queue.splice(0)) {
+      job.reject(new Error("Detection pool closed"));
+    }
+    await Promise.all(workers.map((slot) => slot.worker.terminate()));
+  }
+
+  for (let i = 0; i < size; i++) {
+    spawnWorker();
+  }
+
+  return { submit, close, pending: () => queue.length };
+}
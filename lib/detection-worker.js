@@ -0,0 +1,19 @@
+import { parentPort } from "worker_threads";
+import { detectPackage } from "./package-detector.js";
+import { createRecordingTrace } from "./tracing.js";
+
+// Runs in a worker thread started by lib/detection-pool.js: detection for
+// one frame per message. The annotated image is rendered afterwards, off the
+// publish path (lib/annotation-queue.js).
+parentPort.on("message", async ({ id, framePath, jpeg, roi }) => {
+  const trace = createRecordingTrace();
+  try {
+    // Buffers arrive as plain Uint8Arrays after crossing the thread boundary.
+    // Only the crop is decoded from them, at reduced scale.
+    const data = jpeg ? Buffer.from(jpeg.buffer, jpeg.byteOffset, jpeg.byteLength) : null;
+    const result = await detectPackage(framePath, { trace, jpeg: data, roi });
+    parentPort.postMessage({ id, result, spans: trace.spans });
+  } catch (error) {
+    parentPort.postMessage({ id, error: error.message, spans: trace.spans });
+  }
+});
@@ -0,0 +1,69 @@
+import { logger } from "./logger.js";
+
+/**
+ * Keep an up-to-date view of a Eufy client's devices and stations, driven by
+ * its add/remove events, so lookups never need getDevices().
+ *
+ * @param {EufySecurity} client
+ * @returns {object} - Registry with serial/name lookups and an onChange hook
+ */
+export function createDeviceRegistry(client) {
+  const devicesBySerial = new Map();
+  const devicesByName = new Map(); // lowercase name -> device
+  const stationsBySerial = new Map();
+  const changeListeners = [];
+
+  function notify() {
+    for (const listener of changeListeners) {
+      listener();
+    }
+  }
+
+  client.on("device added", (device) => {
+    devicesBySerial.set(device.getSerial(), device);
+    devicesByName.set(device.getName().toLowerCase(), device);
+    logger.event("device_registry", `Device found: ${device.getName()} (${device.getSerial()})`, {
+      change: "device added",
+      station: device.getStationSerial(),
+    });
+    notify();
+  });
+
+  client.on("device removed", (device) => {
+    devicesBySerial.delete(device.getSerial());
+    if (devicesByName.get(device.getName().toLowerCase()) === device) {
+      devicesByName.delete(device.getName().toLowerCase());
+    }
+    logger.event("device_registry", `Device removed: ${device.getName()} (${device.getSerial()})`, {
+      change: "device removed",
+    });
+    notify();
+  });
+
+  client.on("station added", (station) => {
+    stationsBySerial.set(station.getSerial(), station);
+    logger.event("device_registry", `Station found: ${station.getName()} (${station.getSerial()})`, {
+      change: "station added",
+    });
+    notify();
+  });
+
+  client.on("station removed", (station) => {
+    stationsBySerial.delete(station.getSerial());
+    logger.event("device_registry", `Station removed: ${station.getName()} (${station.getSerial()})`, {
+      change: "station removed",
+    });
+    notify();
+  });
+
+  return {
+    /** @returns {Device|undefined} */
+    getDevice: (serial) => devicesBySerial.get(serial),
+    /** Exact (case-insensitive) name lookup */
+    getDeviceByName: (name) => devicesByName.get(name.toLowerCase()),
+    getStation: (serial) => stationsBySerial.get(serial),
+    devices: () => [...devicesBySerial.values()],
+    /** Register a callback run after every add/remove */
+    onChange: (listener) => changeListeners.push(listener),
+  };
+}
@@ -0,0 +1,218 @@
+import { spawn } from "child_process";
+import { logger } from "./logger.js";
+import { findKeyframeOffset, endOfStreamNals } from "./h26x.js";
+import { createJpegSplitter } from "./jpeg-stream.js";
+
+// How long finish() waits for the picture flushed out of the decoder after
+// the last chunk was written
+const FRAME_DRAIN_MS = 1000;
+
+/**
+ * Spawn an ffmpeg decoder that reads an elementary stream on stdin and
+ * writes JPEGs to stdout, at most one per sampleIntervalS. Timestamps come
+ * from arrival time, so gaps between streams fed to the same process are
+ * real gaps and not duplicated frames. low_delay also keeps the decoder off
+ * frame threading, so the only picture held back is the one ffmpeg's parser
+ * keeps until the next access unit starts (see endOfStreamNals()).
+ *
+ * @param {string} codec - "h264" or "h265"
+ * @param {{sampleIntervalS: number, quality: string}} options
+ */
+export function spawnJpegDecoder(codec, { sampleIntervalS, quality = "2" }) {
+  return spawn("ffmpeg", [
+    "-hide_banner",
+    "-use_wallclock_as_timestamps", "1",
+    "-flags", "low_delay",
+    "-f", codec === "h265" ? "hevc" : "h264",
+    "-i", "pipe:0",
+    "-vf", `select='isnan(prev_selected_t)+gte(t-prev_selected_t\\,${sampleIntervalS})'`,
+    "-vsync", "vfr",
+    "-q:v", quality,
+    "-flush_packets", "1",
+    "-f", "image2pipe",
+    "-c:v", "mjpeg",
+    "pipe:1",
+  ]);
+}
+
+/**
+ * Pool of ffmpeg decoders kept running and waiting on stdin, so a capture's
+ * first video chunk goes to a process that has already paid spawn and
+ * dynamic-link cost. A worker decodes one capture at a time and is recycled
+ * after maxUses captures.
+ *
+ * @param {object} options
+ * @param {number} options.size - Idle workers kept warm per codec
+ * @param {number} options.maxUses - Captures per worker before it is replaced
+ * @param {number} options.sampleIntervalS - Seconds between output frames
+ * @param {string} options.quality - ffmpeg -q:v for the JPEG output
+ * @param {object} options.metrics - Registry from createMetrics()
+ */
+export function createFFmpegPool({ size, maxUses, sampleIntervalS, quality, metrics }) {
+  const idle = new Map(); // codec -> [worker]
+  let closed = false;
+
+  function spawnWorker(codec) {
+    const worker = {
+      codec,
+      proc: spawnJpegDecoder(codec, { sampleIntervalS, quality }),
+      uses: 0,
+      dead: false,
+      onFrame: null, // current job's frame handler
+    };
+    const splitter = createJpegSplitter((jpeg) => {
+      if (worker.onFrame) worker.onFrame(jpeg);
+    });
+
+    worker.proc.stdout.on("data", (data) => splitter.push(data));
+    worker.proc.stderr.on("data", () => {}); // drain; ffmpeg logs progress here
+    worker.proc.stdin.on("error", (err) => {
+      logger.debug("FFmpeg worker stdin error", { error: err.message });
+    });
+    worker.proc.on("error", (err) => {
+      logger.error("FFmpeg process error", { error: err.message });
+    });
+    worker.proc.on("close", (code) => {
+      worker.dead = true;
+      const list = idle.get(codec) || [];
+      if (list.includes(worker)) {
+        // Died while idle; replace it so the pool stays warm
+        idle.set(codec, list.filter((w) => w !== worker));
+        logger.warn("Idle FFmpeg worker exited", { codec, code });
+        refill(codec);
+      }
+      logger.debug("FFmpeg process exited", { code });
+    });
+
+    metrics.increment("ffmpeg_spawns");
+    logger.debug("Spawned FFmpeg worker", { codec });
+    return worker;
+  }
+
+  function refill(codec) {
+    if (closed) return;
+    const list = idle.get(codec) || [];
+    while (list.length < size) {
+      list.push(spawnWorker(codec));
+    }
+    idle.set(codec, list);
+  }
+
+  function retire(worker) {
+    worker.onFrame = null;
+    if (!worker.dead && !worker.proc.stdin.destroyed) {
+      worker.proc.stdin.end();
+    }
+  }
+
+  /**
+   * Keep `size` idle workers running for a codec
+   * @param {string} codec - "h264" or "h265"
+   */
+  function prewarm(codec) {
+    refill(codec);
+  }
+
+  /**
+   * Take a worker for one capture (spawning one if none is warm)
+   * @param {string} codec
+   * @param {(jpeg: Buffer) => void} onFrame - Called for each decoded frame
+   * @returns {{write: (chunk: Buffer) => void, finish: () => Promise<number>, warm: boolean}}
+   */
+  function acquire(codec, onFrame) {
+    const list = idle.get(codec) || [];
+    let worker = list.shift();
+    while (worker && worker.dead) worker = list.shift();
+    const warm = Boolean(worker);
+    if (!worker) worker = spawnWorker(codec);
+    worker.uses++;
+
+    let synced = false; // fed a keyframe for this capture yet
+    let released = false;
+    let frames = 0;
+    let firstWriteAt = 0;
+    let lastWriteAt = 0;
+    let lastFrameAt = 0;
+
+    // Output is not tagged with the stream it came from; the previous
+    // capture's finish() flushed its last picture out before the worker was
+    // pooled, so everything from here on is this capture's
+    worker.onFrame = (jpeg) => {
+      if (frames === 0 && firstWriteAt) {
+        // First keyframe in to first JPEG out; a cold worker is still
+        // starting up when its first chunk is written
+        metrics.observe(
+          warm ? "ffmpeg_first_frame_warm_ms" : "ffmpeg_first_frame_cold_ms",
+          Date.now() - firstWriteAt
+        );
+      }
+      frames++;
+      lastFrameAt = Date.now();
+      onFrame(jpeg);
+    };
+
+    function write(chunk) {
+      // Stream data keeps arriving until the livestream stop command lands
+      if (released || worker.dead || worker.proc.stdin.destroyed) return;
+      if (!synced) {
+        // The decoder may still hold the previous capture's stream state
+        const offset = findKeyframeOffset(chunk, codec);
+        if (offset === -1) return;
+        chunk = chunk.subarray(offset);
+        synced = true;
+      }
+      lastWriteAt = Date.now();
+      if (!firstWriteAt) firstWriteAt = lastWriteAt;
+      worker.proc.stdin.write(chunk);
+    }
+
+    /**
+     * Flush the decoder and wait for its last picture, then release the worker
+     * @returns {Promise<number>} - Frames decoded for this capture
+     */
+    async function finish() {
+      released = true;
+      // Pushes the last access unit through while this capture's onFrame is
+      // still attached; without it the next capture's first write would
+      // bring it out under that capture's handler
+      if (synced && !worker.dead && !worker.proc.stdin.destroyed) {
+        worker.proc.stdin.write(endOfStreamNals(codec));
+        lastWriteAt = Date.now();
+      }
+      const deadline = Date.now() + FRAME_DRAIN_MS;
+      // A frame after the flush means the decoder has caught up. The 1-fps
+      // select may drop the flushed picture instead, and then the wait
+      // times out; the picture is consumed either way.
+      while (Date.now() < deadline && !worker.dead && lastFrameAt <= lastWriteAt) {
+        await new Promise((resolve) => setTimeout(resolve, 50));
+      }
+      worker.onFrame = null;
+
+      const current = idle.get(codec) || [];
+      if (!closed && !worker.dead && worker.uses < maxUses && current.length < size) {
+        current.push(worker);
+        idle.set(codec, current);
+      } else {
+        if (worker.uses >= maxUses) {
+          logger.debug("Recycling FFmpeg worker", { codec, uses: worker.uses });
+        }
+        retire(worker);
+        refill(codec);
+      }
+      return frames;
+    }
+
+    logger.debug("Acquired FFmpeg worker", { codec, warm, uses: worker.uses });
+    return { write, finish, warm };
+  }
+
+  function close() {
+    closed = true;
+    for (const list of idle.values()) {
+      list.forEach(retire);
+    }
+    idle.clear();
+  }
+
+  return { prewarm, acquire, close };
+}
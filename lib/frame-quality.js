@@ -0,0 +1,50 @@
+// Scores a frame's doorstep region for how usable it is for detection, so a
+// capture can skip a newest frame that is blurred or badly exposed. Frames
+// come from the same few seconds of video, so they differ mostly in motion
+// blur and in exposure while the camera adjusts. The raw Laplacian variance
+// also grows with scene detail (a person walking in adds edges), so scores
+// are only meaningful relative to the same capture, and only large
+// differences mean a worse frame (see selectFrame() in capture.js).
+export const QUALITY_WIDTH = 256;
+
+const DARK_LEVEL = 8;
+const BRIGHT_LEVEL = 247;
+
+/**
+ * @param {{width: number, height: number, pixels: Uint8Array}} thumbnail - Grayscale, from
+ *   roiThumbnail() at QUALITY_WIDTH
+ * @returns {{sharpness: number, exposure: number, score: number}} - sharpness is the variance of
+ *   the Laplacian; exposure is 0-1, lower for clipped or very dark/bright frames
+ */
+export function scoreFrame(thumbnail) {
+  const { width, height, pixels } = thumbnail;
+
+  // Variance of the 4-neighbour Laplacian over the interior
+  let sum = 0;
+  let sumSquares = 0;
+  let count = 0;
+  for (let y = 1; y < height - 1; y++) {
+    const row = y * width;
+    for (let x = 1; x < width - 1; x++) {
+      const i = row + x;
+      const laplacian = pixels[i - 1] + pixels[i + 1] + pixels[i - width] + pixels[i + width] - 4 * pixels[i];
+      sum += laplacian;
+      sumSquares += laplacian * laplacian;
+      count++;
+    }
+  }
+  const mean = count > 0 ? sum / count : 0;
+  const sharpness = count > 0 ? sumSquares / count - mean * mean : 0;
+
+  let brightness = 0;
+  let clipped = 0;
+  for (let i = 0; i < pixels.length; i++) {
+    const p = pixels[i];
+    brightness += p;
+    if (p <= DARK_LEVEL || p >= BRIGHT_LEVEL) clipped++;
+  }
+  brightness /= pixels.length;
+  const exposure = (1 - clipped / pixels.length) * (1 - 0.5 * Math.abs(brightness - 128) / 128);
+
+  return { sharpness, exposure, score: sharpness * exposure };
+}
@@ -0,0 +1,40 @@
+/**
+ * Fixed-capacity ring of the most recent decoded frames
+ * @param {number} capacity - Frames kept before the oldest is overwritten
+ */
+export function createFrameRing(capacity) {
+  const slots = new Array(capacity).fill(null);
+  let next = 0;
+  let size = 0;
+  let sequence = 0;
+
+  /**
+   * @param {Buffer} jpeg
+   * @param {number} at - Capture time in ms
+   */
+  function push(jpeg, at = Date.now()) {
+    slots[next] = { jpeg, at, sequence: sequence++ };
+    next = (next + 1) % capacity;
+    size = Math.min(size + 1, capacity);
+  }
+
+  /**
+   * Frames oldest first
+   */
+  function frames() {
+    const result = [];
+    for (let i = 0; i < size; i++) {
+      result.push(slots[(next - size + i + capacity) % capacity]);
+    }
+    return result;
+  }
+
+  /**
+   * @returns {{jpeg: Buffer, at: number, sequence: number}|null}
+   */
+  function latest() {
+    return size > 0 ? slots[(next - 1 + capacity) % capacity] : null;
+  }
+
+  return { push, frames, latest, size: () => size };
+}
@@ -0,0 +1,77 @@
+// Minimal Annex B (start-code delimited) H.264/H.265 elementary stream
+// helpers. Only enough parsing to find where a decoder can (re)start.
+
+const H264_NAL_IDR = 5;
+const H264_NAL_SPS = 7;
+const HEVC_NAL_IDR_W_RADL = 19;
+const HEVC_NAL_IDR_N_LP = 20;
+const HEVC_NAL_VPS = 32;
+const HEVC_NAL_SPS = 33;
+
+// End of sequence followed by an access unit delimiter. The delimiter is what
+// makes ffmpeg's parser hand over the access unit it is holding (it cannot
+// know a picture is complete until the next one starts); end of sequence
+// makes the decoder treat whatever comes next as a new stream.
+const H264_FLUSH = Buffer.from([0, 0, 0, 1, 0x0a, 0, 0, 0, 1, 0x09, 0xf0]);
+const HEVC_FLUSH = Buffer.from([0, 0, 0, 1, 0x48, 0x01, 0, 0, 0, 1, 0x46, 0x01, 0x50]);
+
+function isKeyframeNal(header, codec) {
+  if (codec === "h265") {
+    const type = (header >> 1) & 0x3f;
+    return (
+      type === HEVC_NAL_VPS ||
+      type === HEVC_NAL_SPS ||
+      type === HEVC_NAL_IDR_W_RADL ||
+      type === HEVC_NAL_IDR_N_LP
+    );
+  }
+  const type = header & 0x1f;
+  return type === H264_NAL_SPS || type === H264_NAL_IDR;
+}
+
+/**
+ * Find the first NAL unit in a chunk a decoder can start from (parameter
+ * sets or IDR slice).
+ * @param {Buffer} chunk - Annex B elementary stream data
+ * @param {string} codec - "h264" or "h265"
+ * @returns {number} - Byte offset of the NAL's start code, or -1
+ */
+export function findKeyframeOffset(chunk, codec) {
+  for (let i = 0; i + 3 < chunk.length; i++) {
+    if (chunk[i] !== 0 || chunk[i + 1] !== 0) continue;
+
+    let headerAt;
+    if (chunk[i + 2] === 1) {
+      headerAt = i + 3;
+    } else if (chunk[i + 2] === 0 && chunk[i + 3] === 1 && i + 4 < chunk.length) {
+      headerAt = i + 4;
+    } else {
+      continue;
+    }
+
+    if (isKeyframeNal(chunk[headerAt], codec)) {
+      return i;
+    }
+    i = headerAt - 1;
+  }
+  return -1;
+}
+
+/**
+ * NAL units that push a decoder's last buffered picture out and end the
+ * stream, so a decoder process can be fed another stream afterwards
+ * @param {string} codec - "h264" or "h265"
+ * @returns {Buffer}
+ */
+export function endOfStreamNals(codec) {
+  return codec === "h265" ? HEVC_FLUSH : H264_FLUSH;
+}
+
+/**
+ * Codec name from eufy-security-client livestream metadata
+ * @param {object} metadata
+ * @returns {string} - "h264" or "h265"
+ */
+export function codecFromMetadata(metadata) {
+  return metadata.videoCodec === 1 ? "h265" : "h264";
+}
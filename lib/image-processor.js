@@ -1,16 +1,232 @@
 import sharp from "sharp";
 import path from "path";
 import fs from "fs";
+import { renderOverlay } from "./overlay-renderer.js";
 
 // Proportions based on 1600x2300 reference resolution
 const CROP_START_RATIO = 1500 / 2300; // Look at bottom camera and also ignore part of sidewalk
 const TARGET_WIDTH = 480;
 
-// Text sizing (fixed)
-const TEXT_PADDING = 20;
-const LINE_HEIGHT = 24;
-const FONT_SIZE = 18;
-const MAX_CHARS_PER_LINE = 50;
+/**
+ * Decode a JPEG once into raw pixels. The crop for the API and the
+ * annotated image are both derived from the returned frame, so a capture
+ * cycle decodes its frame only once.
+ * @param {string} inputPath - Path to original image
+ * @param {Buffer} [jpeg] - inputPath's contents if already in memory; the file is not read
+ * @returns {Promise<{path: string, width: number, height: number, channels: number, pixels: Buffer}>}
+ */
+export async function loadFrame(inputPath, jpeg = null) {
+  const { data, info } = await sharp(jpeg || inputPath).raw().toBuffer({ resolveWithObject: true });
+  return {
+    path: inputPath,
+    width: info.width,
+    height: info.height,
+    channels: info.channels,
+    pixels: data,
+  };
+}
+
+function frameImage(frame) {
+  return sharp(frame.pixels, {
+    raw: { width: frame.width, height: frame.height, channels: frame.channels },
+  });
+}
+
+/**
+ * Default region of interest: a band from CROP_START_RATIO to the bottom.
+ * A region is a polygon of [x, y] points as fractions of the frame's
+ * width and height, so it applies at any resolution.
+ */
+export const DEFAULT_ROI = [[0, CROP_START_RATIO], [1, CROP_START_RATIO], [1, 1], [0, 1]];
+
+const ROI_CACHE_LIMIT = 32;
+const roiCache = new Map(); // "<w>x<h>:<points>" -> geometry from roiGeometry()
+
+/**
+ * Check a region from config
+ * @param {Array<[number, number]>} roi - Polygon, fractions of width/height
+ * @throws {Error} If it is not a polygon inside the frame
+ */
+export function validateRoi(roi) {
+  if (!Array.isArray(roi) || roi.length < 3) {
+    throw new Error("ROI must be a polygon of at least 3 [x, y] points");
+  }
+  for (const point of roi) {
+    if (!Array.isArray(point) || point.length !== 2 || point.some((v) => typeof v !== "number" || v < 0 || v > 1)) {
+      throw new Error(`ROI point ${JSON.stringify(point)} must be [x, y] with 0 <= x, y <= 1`);
+    }
+  }
+}
+
+/**
+ * Rasterize a region at one resolution (cached): its bounding box and a
+ * mask of the pixels whose centers are inside the polygon
+ * @returns {{left: number, top: number, width: number, height: number, mask: Uint8Array, full: boolean}}
+ */
+function roiGeometry(roi, width, height) {
+  const key = `${width}x${height}:${roi.join(";")}`;
+  let geometry = roiCache.get(key);
+  if (geometry) return geometry;
+
+  const xs = roi.map(([x]) => x * width);
+  const ys = roi.map(([, y]) => y * height);
+  // Rounded like the crop always was, so edges along pixel rows stay full
+  const left = Math.max(0, Math.round(Math.min(...xs)));
+  const top = Math.max(0, Math.round(Math.min(...ys)));
+  const w = Math.min(width, Math.round(Math.max(...xs))) - left;
+  const h = Math.min(height, Math.round(Math.max(...ys))) - top;
+  if (w <= 0 || h <= 0) {
+    throw new Error(`ROI has no area at ${width}x${height}`);
+  }
+
+  // Even-odd scanline fill at pixel centers
+  const mask = new Uint8Array(w * h);
+  let inside = 0;
+  for (let row = 0; row < h; row++) {
+    const yc = top + row + 0.5;
+    const crossings = [];
+    for (let i = 0, j = roi.length - 1; i < roi.length; j = i++) {
+      if ((ys[i] <= yc) !== (ys[j] <= yc)) {
+        crossings.push(xs[i] + ((yc - ys[i]) * (xs[j] - xs[i])) / (ys[j] - ys[i]));
+      }
+    }
+    crossings.sort((a, b) => a - b);
+    for (let k = 0; k + 1 < crossings.length; k += 2) {
+      const from = Math.max(0, Math.ceil(crossings[k] - left - 0.5));
+      const to = Math.min(w - 1, Math.floor(crossings[k + 1] - left - 0.5));
+      if (to >= from) {
+        mask.fill(1, row * w + from, row * w + to + 1);
+        inside += to - from + 1;
+      }
+    }
+  }
+
+  geometry = { left, top, width: w, height: h, mask, full: inside === w * h };
+  if (roiCache.size >= ROI_CACHE_LIMIT) roiCache.clear();
+  roiCache.set(key, geometry);
+  return geometry;
+}
+
+/**
+ * The region's bounding box out of raw pixels, with pixels outside the
+ * polygon set to black
+ */
+function extractRoi(data, info, roi) {
+  const g = roiGeometry(roi || DEFAULT_ROI, info.width, info.height);
+  const channels = info.channels;
+  const rowBytes = g.width * channels;
+  const pixels = Buffer.allocUnsafe(g.height * rowBytes);
+  for (let row = 0; row < g.height; row++) {
+    const src = ((g.top + row) * info.width + g.left) * channels;
+    data.copy(pixels, row * rowBytes, src, src + rowBytes);
+    if (g.full) continue;
+    const maskRow = row * g.width;
+    for (let x = 0; x < g.width; x++) {
+      if (!g.mask[maskRow + x]) pixels.fill(0, row * rowBytes + x * channels, row * rowBytes + (x + 1) * channels);
+    }
+  }
+  return { width: g.width, height: g.height, channels, pixels };
+}
+
+/**
+ * Decode a JPEG scaled so the region's bounding box is about roiWidth
+ * wide (libjpeg then decodes at reduced scale), and extract the region
+ * @param {string|Buffer} input - JPEG path or contents
+ */
+async function decodeRoi(input, roi, roiWidth, { grayscale = false } = {}) {
+  const xs = (roi || DEFAULT_ROI).map(([x]) => x);
+  const widthFraction = Math.max(...xs) - Math.min(...xs);
+  let image = sharp(input, { sequentialRead: true }).resize({
+    width: Math.round(roiWidth / widthFraction),
+    withoutEnlargement: true,
+  });
+  if (grayscale) image = image.grayscale();
+  const { data, info } = await image.raw().toBuffer({ resolveWithObject: true });
+  return extractRoi(data, info, roi);
+}
+
+function rawImage(region) {
+  return sharp(region.pixels, {
+    raw: { width: region.width, height: region.height, channels: region.channels },
+  });
+}
+
+/**
+ * Crop a decoded frame to the doorstep region and downscale it for the API
+ * @param {object} frame - From loadFrame()
+ * @param {Array<[number, number]>|null} [roi] - Region polygon (default DEFAULT_ROI)
+ * @returns {Promise<Buffer>} - JPEG
+ */
+export async function cropAndScaleFrame(frame, roi = null) {
+  const region = extractRoi(frame.pixels, frame, roi);
+  return rawImage(region).resize({ width: TARGET_WIDTH }).jpeg().toBuffer();
+}
+
+/**
+ * Crop and downscale straight from a JPEG file, for callers that do not
+ * need the full-resolution frame. Cropping commutes with scaling, so this
+ * scales first: libjpeg then decodes with a 1/2 (or smaller) scaled IDCT
+ * and the full-size image is never built.
+ * @param {string|Buffer} input - Path to original image, or its contents
+ * @param {Array<[number, number]>|null} [roi] - Region polygon (default DEFAULT_ROI)
+ * @returns {Promise<Buffer>} - JPEG, same region and size as cropAndScaleFrame()
+ */
+export async function cropAndScaleJpeg(input, roi = null) {
+  return rawImage(await decodeRoi(input, roi, TARGET_WIDTH)).jpeg().toBuffer();
+}
+
+/**
+ * Small grayscale thumbnail of the doorstep region, for cheap comparisons
+ * between frames. Scaling first lets libjpeg decode at 1/8 size. Pixels
+ * outside a polygon region are 0 in every thumbnail, so never differ.
+ * @param {string|Buffer} input - JPEG path or contents
+ * @param {number} width - Thumbnail width in pixels
+ * @param {Array<[number, number]>|null} [roi] - Region polygon (default DEFAULT_ROI)
+ * @returns {Promise<{width: number, height: number, pixels: Uint8Array}>}
+ */
+export async function roiThumbnail(input, width, roi = null) {
+  const region = await decodeRoi(input, roi, width, { grayscale: true });
+  const { pixels } = region;
+  return {
+    width: region.width,
+    height: region.height,
+    pixels: new Uint8Array(pixels.buffer, pixels.byteOffset, pixels.length),
+  };
+}
+
+/**
+ * The doorstep region squashed to a size x size grayscale square, the
+ * input to a perceptual hash
+ * @param {string|Buffer} input - JPEG path or contents
+ * @param {number} size - Side in pixels
+ * @param {Array<[number, number]>|null} [roi] - Region polygon (default DEFAULT_ROI)
+ * @returns {Promise<{width: number, height: number, pixels: Uint8Array}>}
+ */
+export async function roiSquare(input, size, roi = null) {
+  const region = await decodeRoi(input, roi, size * 4, { grayscale: true });
+  const data = await rawImage(region).resize(size, size, { fit: "fill" }).raw().toBuffer();
+  return { width: size, height: size, pixels: new Uint8Array(data.buffer, data.byteOffset, data.length) };
+}
+
+/**
+ * The doorstep region squashed to a size x size RGB square, the input to
+ * the local classifier
+ * @param {string|Buffer|object} input - JPEG path or contents, or a frame from loadFrame()
+ * @param {number} size - Side in pixels
+ * @param {Array<[number, number]>|null} [roi] - Region polygon (default DEFAULT_ROI)
+ * @returns {Promise<Buffer>} - size * size * 3 bytes, RGB interleaved
+ */
+export async function roiRgb(input, size, roi = null) {
+  // A JPEG is scaled while decoding; the crop is never decoded at full size
+  const region = typeof input === "string" || Buffer.isBuffer(input)
+    ? await decodeRoi(input, roi, size * 2)
+    : extractRoi(input.pixels, input, roi);
+  return rawImage(region)
+    .resize(size, size, { fit: "fill" })
+    .removeAlpha()
+    .raw()
+    .toBuffer();
+}
 
 /**
  * Crop image starting at CROP_START_Y and downscale by SCALE_FACTOR
@@ -42,111 +258,53 @@ export async function cropAndScale(inputPath) {
 }
 
 /**
- * Wrap text to fit within maxChars per line
- * @param {string} text
- * @param {number} maxChars
- * @returns {string[]}
+ * Where the annotated copy of a frame goes: the sibling snapshots_annotated
+ * folder, created if needed
+ * @param {string} inputPath - Path to original image
+ * @returns {string}
  */
-function wrapText(text, maxChars = MAX_CHARS_PER_LINE) {
-  const words = text.split(" ");
-  const lines = [];
-  let currentLine = "";
-
-  for (const word of words) {
-    if ((currentLine + " " + word).trim().length <= maxChars) {
-      currentLine = (currentLine + " " + word).trim();
-    } else {
-      if (currentLine) lines.push(currentLine);
-      currentLine = word;
-    }
+export function annotatedPathFor(inputPath) {
+  const dir = path.dirname(inputPath);
+  const parentDir = path.dirname(dir);
+  const annotatedDir = path.join(parentDir, "snapshots_annotated");
+
+  if (!fs.existsSync(annotatedDir)) {
+    fs.mkdirSync(annotatedDir, { recursive: true });
   }
-  if (currentLine) lines.push(currentLine);
 
-  return lines;
+  const baseName = path.basename(inputPath, ".jpg");
+  return path.join(annotatedDir, `${baseName}_annotated.jpg`);
 }
 
 /**
  * Add detection result text overlay to the top of the original image
- * @param {string} inputPath - Path to original image
+ * @param {string|object} input - Path to original image, or a frame from loadFrame()
  * @param {object} result - Detection result {package_detected, confidence, description}
  * @param {string} outputPath - Path for output image (optional, defaults to snapshots_annotated folder)
  * @returns {Promise<string>} - Path to annotated image
  */
-export async function addTextOverlay(inputPath, result, outputPath = null) {
-  const metadata = await sharp(inputPath).metadata();
+export async function addTextOverlay(input, result, outputPath = null) {
+  // A decoded frame already knows its size and needs no second decode
+  const frame = typeof input === "string" ? null : input;
+  const inputPath = frame ? frame.path : input;
+  const metadata = frame || (await sharp(inputPath).metadata());
 
   if (!outputPath) {
-    // Save to sibling snapshots_annotated folder
-    const dir = path.dirname(inputPath);
-    const parentDir = path.dirname(dir);
-    const annotatedDir = path.join(parentDir, "snapshots_annotated");
-
-    if (!fs.existsSync(annotatedDir)) {
-      fs.mkdirSync(annotatedDir, { recursive: true });
-    }
-
-    const baseName = path.basename(inputPath, ".jpg");
-    outputPath = path.join(annotatedDir, `${baseName}_annotated.jpg`);
+    outputPath = annotatedPathFor(inputPath);
   }
 
   const overlayHeight = Math.round(metadata.height * CROP_START_RATIO);
 
-  const decision = result.package_detected ? "PACKAGE DETECTED" : "NO PACKAGE";
-  const decisionColor = result.package_detected ? "#00FF00" : "#FF6600";
-  const confidence = `(${result.confidence} confidence)`;
-  const descriptionLines = wrapText(result.description || "");
-
-  // Build SVG overlay
-  let y = TEXT_PADDING + LINE_HEIGHT;
-  let svgText = `
-    <text x="${TEXT_PADDING}" y="${y}" font-size="${FONT_SIZE}" font-weight="bold" fill="${decisionColor}" font-family="Arial, sans-serif">${decision}</text>
-  `;
-  y += LINE_HEIGHT;
-
-  svgText += `
-    <text x="${TEXT_PADDING}" y="${y}" font-size="${FONT_SIZE}" fill="#FFFFFF" font-family="Arial, sans-serif">${confidence}</text>
-  `;
-  y += LINE_HEIGHT;
-
-  for (const line of descriptionLines) {
-    svgText += `
-      <text x="${TEXT_PADDING}" y="${y}" font-size="${FONT_SIZE}" fill="#CCCCCC" font-family="Arial, sans-serif">${escapeXml(line)}</text>
-    `;
-    y += LINE_HEIGHT - 5;
-  }
+  // Drawn from cached sprites (lib/overlay-renderer.js) rather than an SVG per image
+  const overlay = await renderOverlay(metadata.width, overlayHeight, result);
 
-  const svgOverlay = `
-    <svg width="${metadata.width}" height="${overlayHeight}">
-      <rect x="0" y="0" width="${metadata.width}" height="${overlayHeight}" fill="rgba(0,0,0,0.7)"/>
-      ${svgText}
-    </svg>
-  `;
-
-  await sharp(inputPath)
-    .composite([
-      {
-        input: Buffer.from(svgOverlay),
-        top: 0,
-        left: 0,
-      },
-    ])
+  await (frame ? frameImage(frame) : sharp(inputPath))
+    .composite(overlay)
     .toFile(outputPath);
 
   return outputPath;
 }
 
-/**
- * Escape special XML characters
- */
-function escapeXml(text) {
-  return text
-    .replace(/&/g, "&amp;")
-    .replace(/</g, "&lt;")
-    .replace(/>/g, "&gt;")
-    .replace(/"/g, "&quot;")
-    .replace(/'/g, "&apos;");
-}
-
 /**
  * Clean up temporary cropped/scaled file
  * @param {string} tempPath
@@ -0,0 +1,41 @@
+// Split a concatenated JPEG stream (ffmpeg -f image2pipe -c:v mjpeg) back
+// into individual images. Entropy-coded data byte-stuffs 0xFF, so the first
+// FFD9 after an FFD8 ends the image.
+
+const SOI = Buffer.from([0xff, 0xd8]);
+const EOI = Buffer.from([0xff, 0xd9]);
+
+/**
+ * @param {(jpeg: Buffer) => void} onFrame - Called once per complete JPEG
+ * @returns {{push: (chunk: Buffer) => void, reset: () => void}}
+ */
+export function createJpegSplitter(onFrame) {
+  let pending = Buffer.alloc(0);
+
+  function push(chunk) {
+    pending = pending.length > 0 ? Buffer.concat([pending, chunk]) : chunk;
+
+    let searchFrom = 0;
+    while (true) {
+      const start = pending.indexOf(SOI, searchFrom);
+      if (start === -1) {
+        // Keep a trailing 0xFF in case it is the first half of the next SOI
+        pending = pending[pending.length - 1] === 0xff ? pending.subarray(-1) : Buffer.alloc(0);
+        return;
+      }
+      const end = pending.indexOf(EOI, start + 2);
+      if (end === -1) {
+        pending = pending.subarray(start);
+        return;
+      }
+      onFrame(Buffer.from(pending.subarray(start, end + 2)));
+      searchFrom = end + 2;
+    }
+  }
+
+  function reset() {
+    pending = Buffer.alloc(0);
+  }
+
+  return { push, reset };
+}
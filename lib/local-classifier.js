@@ -0,0 +1,101 @@
+import fs from "fs";
+import { logger } from "./logger.js";
+import { roiRgb } from "./image-processor.js";
+
+// Small on-CPU image classifier run before the LLM. The model is an ONNX
+// file (e.g. a quantized MobileNet fine-tuned on the doorstep crop) taking
+// a [1, 3, INPUT_SIZE, INPUT_SIZE] float tensor normalized with the ImageNet
+// mean/std, and returning [1, 2] logits: package present, person present.
+// onnxruntime-node is optional and only loaded when LOCAL_MODEL is set.
+const INPUT_SIZE = 224;
+const MEAN = [0.485, 0.456, 0.406];
+const STD = [0.229, 0.224, 0.225];
+
+/**
+ * Pack an interleaved RGB square into a normalized NCHW float tensor
+ * @param {Buffer} rgb - From roiRgb()
+ * @returns {Float32Array}
+ */
+function toTensorData(rgb) {
+  const plane = INPUT_SIZE * INPUT_SIZE;
+  const data = new Float32Array(3 * plane);
+  for (let i = 0; i < plane; i++) {
+    for (let c = 0; c < 3; c++) {
+      data[c * plane + i] = (rgb[i * 3 + c] / 255 - MEAN[c]) / STD[c];
+    }
+  }
+  return data;
+}
+
+function sigmoid(x) {
+  return 1 / (1 + Math.exp(-x));
+}
+
+/**
+ * Load the ONNX model at modelPath
+ * @param {string} modelPath
+ * @param {object} [options]
+ * @param {number} [options.threads] - intra-op threads; 1 leaves the other cores to other workers
+ * @returns {Promise<{score: function(string|object, Array?): Promise<{package: number, person: number}>}>}
+ */
+export async function loadLocalClassifier(modelPath, { threads = 1 } = {}) {
+  if (!fs.existsSync(modelPath)) {
+    throw new Error(`Local model not found at ${modelPath}`);
+  }
+
+  let ort;
+  try {
+    ort = await import("onnxruntime-node");
+  } catch {
+    throw new Error("LOCAL_MODEL is set but onnxruntime-node is not installed (npm install onnxruntime-node)");
+  }
+
+  const session = await ort.InferenceSession.create(modelPath, {
+    executionProviders: ["cpu"],
+    intraOpNumThreads: threads,
+    graphOptimizationLevel: "all",
+  });
+  const [inputName] = session.inputNames;
+  const [outputName] = session.outputNames;
+  logger.info("Loaded local classifier", { model: modelPath, inputName, outputName });
+
+  /**
+   * @param {string|Buffer|object} input - JPEG path or contents, or a frame from loadFrame()
+   * @param {Array<[number, number]>|null} [roi] - Doorstep polygon, see roiRgb()
+   * @returns {Promise<{package: number, person: number}>} - Probabilities
+   */
+  async function score(input, roi = null) {
+    const rgb = await roiRgb(input, INPUT_SIZE, roi);
+    const tensor = new ort.Tensor("float32", toTensorData(rgb), [1, 3, INPUT_SIZE, INPUT_SIZE]);
+    const output = await session.run({ [inputName]: tensor });
+    const logits = output[outputName].data;
+    return { package: sigmoid(logits[0]), person: sigmoid(logits[1]) };
+  }
+
+  return { score };
+}
+
+/**
+ * Turn classifier scores into a detection result, or null when they are
+ * too uncertain to answer without the LLM
+ * @param {{package: number, person: number}} scores
+ * @param {{low: number, high: number}} thresholds - Below low is a confident no, above high a confident yes
+ * @param {boolean} [forced] - Always answer (the LLM is unavailable), at low confidence if uncertain
+ * @returns {{package_detected: boolean, confidence: string, description: string}|null}
+ */
+export function decideLocally(scores, { low, high }, forced = false) {
+  const summary = `package ${scores.package.toFixed(2)}, person ${scores.person.toFixed(2)}`;
+  // A person at the door means the package is not unattended
+  if (scores.package <= low || scores.person >= high) {
+    return { package_detected: false, confidence: "high", description: `Local model: ${summary}` };
+  }
+  if (scores.package >= high && scores.person <= low) {
+    return { package_detected: true, confidence: "high", description: `Local model: ${summary}` };
+  }
+  if (!forced) return null;
+  return {
+    package_detected: scores.package >= 0.5 && scores.person < 0.5,
+    confidence: "low",
+    description: `Local model (LLM unavailable): ${summary}`,
+  };
+}
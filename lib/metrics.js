@@ -0,0 +1,92 @@
+import fs from "fs";
+import path from "path";
+import { logger } from "./logger.js";
+
+const DATA_DIR = "./data";
+const MAX_SAMPLES = 1000;
+
+/**
+ * Nearest-rank percentile of a sorted array
+ * @param {number[]} sorted
+ * @param {number} p - Percentile in [0, 100]
+ */
+function percentile(sorted, p) {
+  if (sorted.length === 0) return null;
+  const rank = Math.ceil((p / 100) * sorted.length) - 1;
+  return sorted[Math.min(sorted.length - 1, Math.max(0, rank))];
+}
+
+/**
+ * Summarize a list of samples as count/min/max/p50/p95/p99
+ * @param {number[]} samples
+ */
+export function summarize(samples) {
+  const sorted = [...samples].sort((a, b) => a - b);
+  return {
+    count: sorted.length,
+    min: sorted[0] ?? null,
+    max: sorted[sorted.length - 1] ?? null,
+    p50: percentile(sorted, 50),
+    p95: percentile(sorted, 95),
+    p99: percentile(sorted, 99),
+  };
+}
+
+/**
+ * Create an in-process metrics registry with counters and latency samples.
+ * Samples are kept in a bounded window (last MAX_SAMPLES per metric).
+ *
+ * @param {string} name - Registry name; flush() writes data/metrics-<name>.json
+ */
+export function createMetrics(name) {
+  const startedAt = Date.now();
+  const counters = new Map();
+  const samples = new Map();
+
+  function increment(metric, by = 1) {
+    counters.set(metric, (counters.get(metric) || 0) + by);
+  }
+
+  function observe(metric, value) {
+    let list = samples.get(metric);
+    if (!list) {
+      list = [];
+      samples.set(metric, list);
+    }
+    list.push(value);
+    if (list.length > MAX_SAMPLES) list.shift();
+  }
+
+  function snapshot() {
+    const elapsedDays = (Date.now() - startedAt) / (24 * 60 * 60 * 1000);
+    return {
+      name,
+      since: new Date(startedAt).toISOString(),
+      counters: Object.fromEntries(counters),
+      // Counters extrapolated to a full day, so runs of different length compare
+      perDay: Object.fromEntries(
+        [...counters].map(([k, v]) => [k, elapsedDays > 0 ? Math.round(v / elapsedDays) : null])
+      ),
+      latencies: Object.fromEntries([...samples].map(([k, v]) => [k, summarize(v)])),
+    };
+  }
+
+  /**
+   * Log the current snapshot and write it to data/metrics-<name>.json
+   */
+  function flush() {
+    const snap = snapshot();
+    logger.event("metrics", `Metrics for ${name}`, snap);
+    try {
+      if (!fs.existsSync(DATA_DIR)) {
+        fs.mkdirSync(DATA_DIR, { recursive: true });
+      }
+      fs.writeFileSync(path.join(DATA_DIR, `metrics-${name}.json`), JSON.stringify(snap, null, 2));
+    } catch (error) {
+      logger.warn(`Could not write metrics: ${error.message}`);
+    }
+    return snap;
+  }
+
+  return { increment, observe, snapshot, flush };
+}
@@ -11,6 +11,9 @@ export const MQTT_PORT = process.env.MQTT_PORT || 2000;
 export const MQTT_USER = process.env.MQTT_USER || "user";
 export const MQTT_PASSWORD = process.env.MQTT_PASSWORD || "pass";
 
+const RECONNECT_PERIOD_MS = 5000; // createPublisher() retry interval
+const PUBLISH_QUEUE_LIMIT = 100; // createPublisher() publishes held while disconnected
+
 // ============================================
 // MQTT Topics
 // ============================================
@@ -19,6 +22,30 @@ export const TOPIC_PACKAGE_EXISTS = "package_exists";
 export const TOPIC_USER_HANDLED = "user_handled";
 export const TOPIC_LED_FLASHING = "led_flashing";
 
+/**
+ * Per-camera package_exists topic, e.g. "package_exists/front-door".
+ * The bare TOPIC_PACKAGE_EXISTS is still accepted by the server as a
+ * single legacy camera.
+ * @param {string} cameraKey
+ * @returns {string}
+ */
+export function packageExistsTopic(cameraKey) {
+  return cameraKey ? `${TOPIC_PACKAGE_EXISTS}/${cameraKey}` : TOPIC_PACKAGE_EXISTS;
+}
+
+/**
+ * Extract the camera key from a package_exists topic
+ * @param {string} topic
+ * @returns {string|null} - Camera key, "" for the legacy topic, null if not a package_exists topic
+ */
+export function cameraKeyFromTopic(topic) {
+  if (topic === TOPIC_PACKAGE_EXISTS) return "";
+  if (topic.startsWith(`${TOPIC_PACKAGE_EXISTS}/`)) {
+    return topic.slice(TOPIC_PACKAGE_EXISTS.length + 1);
+  }
+  return null;
+}
+
 // ============================================
 // Client Management
 // ============================================
@@ -62,46 +89,171 @@ export async function createClient(clientIdPrefix) {
 }
 
 /**
- * Publish package detection status
- * @param {mqtt.MqttClient} client - Connected MQTT client
- * @param {boolean} packageExists - Whether a package was detected
- * @returns {Promise<void>}
+ * Create a long-lived publishing client that reconnects on its own.
+ * Publishes made while disconnected wait in an in-memory queue and are sent
+ * in order after reconnecting; for retained topics only the latest queued
+ * value is kept. publish() resolves once the broker confirms delivery
+ * (PUBACK for QoS 1).
+ *
+ * @param {string} clientIdPrefix - Prefix for the client ID
+ * @param {object} [options]
+ * @param {number} [options.queueLimit] - Queued publishes kept while disconnected
+ * @param {number} [options.timeoutMs] - Reject a publish not confirmed within this long,
+ *   queued or in flight; 0 waits for the broker indefinitely
+ * @returns {{publish: (topic: string, message: string, options?: object) => Promise<void>,
+ *   close: () => Promise<void>, queuesWhileOffline: true}}
  */
-export async function publishPackageStatus(client, packageExists) {
+export function createPublisher(clientIdPrefix, { queueLimit = PUBLISH_QUEUE_LIMIT, timeoutMs = 0 } = {}) {
+  const clientId = `${clientIdPrefix}-${Date.now()}-${Math.random().toString(16).slice(2, 8)}`;
+  const queue = []; // [{topic, message, options, waiters: [{resolve, reject}]}]
+
+  logger.info(`Connecting to MQTT broker at ${MQTT_HOST}:${MQTT_PORT}`);
+
+  const client = mqtt.connect(`mqtt://${MQTT_HOST}:${MQTT_PORT}`, {
+    clientId,
+    username: MQTT_USER,
+    password: MQTT_PASSWORD,
+    connectTimeout: 10000,
+    reconnectPeriod: RECONNECT_PERIOD_MS,
+  });
+
+  client.on("connect", () => {
+    logger.info("Connected to MQTT broker", { clientId, queued: queue.length });
+    drain();
+  });
+  client.on("offline", () => {
+    logger.warn("MQTT broker connection lost; queueing publishes", { clientId });
+  });
+  client.on("error", (err) => {
+    logger.error("MQTT connection error", { error: err.message });
+  });
+
+  function send(entry) {
+    client.publish(entry.topic, entry.message, entry.options, (err) => {
+      for (const waiter of entry.waiters) {
+        if (err) waiter.reject(err);
+        else waiter.resolve();
+      }
+    });
+  }
+
+  function drain() {
+    while (queue.length > 0 && client.connected) {
+      send(queue.shift());
+    }
+  }
+
+  function publish(topic, message, options = {}) {
+    return new Promise((resolve, reject) => {
+      const waiter = { resolve, reject };
+      const entry = { topic, message, options, waiters: [waiter] };
+      if (timeoutMs > 0) {
+        const timer = setTimeout(() => {
+          // Still queued: drop it once nobody is waiting for it
+          const queued = queue.find((e) => e.waiters.includes(waiter));
+          if (queued) {
+            queued.waiters.splice(queued.waiters.indexOf(waiter), 1);
+            if (queued.waiters.length === 0) queue.splice(queue.indexOf(queued), 1);
+          }
+          reject(new Error(`MQTT publish to ${topic} not confirmed within ${timeoutMs}ms`));
+        }, timeoutMs);
+        waiter.resolve = () => {
+          clearTimeout(timer);
+          resolve();
+        };
+        waiter.reject = (error) => {
+          clearTimeout(timer);
+          reject(error);
+        };
+      }
+      if (client.connected) {
+        send(entry);
+        return;
+      }
+
+      if (options.retain) {
+        // A newer retained value replaces a queued one; both callers are
+        // confirmed when it is delivered
+        const index = queue.findIndex((e) => e.topic === topic && e.options.retain);
+        if (index !== -1) {
+          entry.waiters.unshift(...queue[index].waiters);
+          queue.splice(index, 1);
+        }
+      }
+      if (queue.length >= queueLimit) {
+        const dropped = queue.shift();
+        const error = new Error(`MQTT outbound queue full; dropped publish to ${dropped.topic}`);
+        dropped.waiters.forEach((waiter) => waiter.reject(error));
+      }
+      queue.push(entry);
+    });
+  }
+
+  /**
+   * Disconnect once in-flight publishes are confirmed; queued ones are dropped
+   */
+  async function close() {
+    for (const entry of queue.splice(0)) {
+      entry.waiters.forEach((waiter) => waiter.reject(new Error("MQTT publisher closed")));
+    }
+    await disconnect(client);
+  }
+
+  return { publish, close, queuesWhileOffline: true };
+}
+
+/**
+ * Publish to a client from createClient() or createPublisher()
+ */
+function publishMessage(client, topic, message, options) {
+  // Publishers queue while disconnected; plain clients must be connected
+  if (client?.queuesWhileOffline) {
+    return client.publish(topic, message, options);
+  }
   return new Promise((resolve, reject) => {
     if (!client || !client.connected) {
       reject(new Error("MQTT client not connected"));
       return;
     }
+    client.publish(topic, message, options, (err) => (err ? reject(err) : resolve()));
+  });
+}
 
-    const message = JSON.stringify({
-      exists: packageExists,
-      timestamp: new Date().toISOString(),
+/**
+ * Publish package detection status
+ * @param {mqtt.MqttClient|object} client - Connected MQTT client, or a publisher from createPublisher()
+ * @param {boolean} packageExists - Whether a package was detected
+ * @param {string} cameraKey - Camera the result belongs to (optional, legacy topic if omitted)
+ * @param {{traceId: string, spanId: string}} [traceContext] - Carried in the payload so the
+ *   server can continue the trace
+ * @returns {Promise<void>}
+ */
+export async function publishPackageStatus(client, packageExists, cameraKey = "", traceContext = null) {
+  const topic = packageExistsTopic(cameraKey);
+  const message = JSON.stringify({
+    exists: packageExists,
+    camera: cameraKey || undefined,
+    timestamp: new Date().toISOString(),
+    trace: traceContext || undefined,
+  });
+
+  logger.info(`Publishing to ${topic}`, { packageExists });
+
+  try {
+    await publishMessage(client, topic, message, {
+      qos: 1,
+      retain: true, // Retain message so new subscribers get last state
+    });
+  } catch (err) {
+    logger.error("Failed to publish package status", {
+      error: err.message,
     });
+    throw err;
+  }
 
-    logger.info(`Publishing to ${TOPIC_PACKAGE_EXISTS}`, { packageExists });
-
-    client.publish(
-      TOPIC_PACKAGE_EXISTS,
-      message,
-      {
-        qos: 1,
-        retain: true, // Retain message so new subscribers get last state
-      },
-      (err) => {
-        if (err) {
-          logger.error("Failed to publish package status", {
-            error: err.message,
-          });
-          reject(err);
-        } else {
-          logger.info("Package status published successfully", {
-            packageExists,
-          });
-          resolve();
-        }
-      }
-    );
+  logger.info("Package status published successfully", {
+    packageExists,
+    camera: cameraKey || undefined,
   });
 }
 
@@ -0,0 +1,224 @@
+import sharp from "sharp";
+
+// Renders the detection overlay (the translucent band over the top of the
+// frame, the decision header, the confidence label and the wrapped
+// description) as raw RGBA layers for sharp's composite(), without
+// rasterizing an SVG per image. The band is cached per frame size and every
+// line of text per string, in the same face and color overlaySvg() uses, so
+// librsvg only runs for a frame size or line not seen recently. Reused
+// results (change gate, pHash cache) and the fixed header and label lines
+// always hit; a new description costs one small rasterization per line.
+export const TEXT_PADDING = 20;
+export const LINE_HEIGHT = 24;
+export const FONT_SIZE = 18;
+export const MAX_CHARS_PER_LINE = 50;
+
+const FONT_FAMILY = "Arial, sans-serif";
+const BAND_ALPHA = Math.round(0.7 * 255);
+
+// Text sprites are one line tall, baseline SPRITE_BASELINE px from the top
+const SPRITE_HEIGHT = 28;
+const SPRITE_BASELINE = 20;
+const LABEL_WIDTH = 640; // MAX_CHARS_PER_LINE of wide glyphs at FONT_SIZE
+
+const BAND_CACHE_LIMIT = 8;
+const LABEL_CACHE_LIMIT = 64; // ~72 KB each
+
+const bands = new Map(); // "WxH" -> Buffer
+const labels = new Map(); // "fill|bold|text" -> Promise<sprite>
+
+/**
+ * Wrap text to fit within maxChars per line
+ * @param {string} text
+ * @param {number} maxChars
+ * @returns {string[]}
+ */
+export function wrapText(text, maxChars = MAX_CHARS_PER_LINE) {
+  const words = text.split(" ");
+  const lines = [];
+  let currentLine = "";
+
+  for (const word of words) {
+    if ((currentLine + " " + word).trim().length <= maxChars) {
+      currentLine = (currentLine + " " + word).trim();
+    } else {
+      if (currentLine) lines.push(currentLine);
+      currentLine = word;
+    }
+  }
+  if (currentLine) lines.push(currentLine);
+
+  return lines;
+}
+
+/**
+ * Escape special XML characters
+ */
+function escapeXml(text) {
+  return text
+    .replace(/&/g, "&amp;")
+    .replace(/</g, "&lt;")
+    .replace(/>/g, "&gt;")
+    .replace(/"/g, "&quot;")
+    .replace(/'/g, "&apos;");
+}
+
+/**
+ * Header, label and color for a detection result
+ */
+function overlayText(result) {
+  return {
+    decision: result.package_detected ? "PACKAGE DETECTED" : "NO PACKAGE",
+    decisionColor: result.package_detected ? "#00FF00" : "#FF6600",
+    confidence: `(${result.confidence} confidence)`,
+  };
+}
+
+/**
+ * The overlay as a single SVG, rasterized by librsvg on every call. This was
+ * the only renderer before the cached one; kept for comparison in
+ * scripts/test-capture-crop.js --bench.
+ * @param {number} width
+ * @param {number} height
+ * @param {object} result - Detection result {package_detected, confidence, description}
+ * @returns {string}
+ */
+export function overlaySvg(width, height, result) {
+  const { decision, decisionColor, confidence } = overlayText(result);
+
+  let y = TEXT_PADDING + LINE_HEIGHT;
+  let svgText = `
+    <text x="${TEXT_PADDING}" y="${y}" font-size="${FONT_SIZE}" font-weight="bold" fill="${decisionColor}" font-family="${FONT_FAMILY}">${decision}</text>
+  `;
+  y += LINE_HEIGHT;
+
+  svgText += `
+    <text x="${TEXT_PADDING}" y="${y}" font-size="${FONT_SIZE}" fill="#FFFFFF" font-family="${FONT_FAMILY}">${escapeXml(confidence)}</text>
+  `;
+  y += LINE_HEIGHT;
+
+  for (const line of wrapText(result.description || "")) {
+    svgText += `
+      <text x="${TEXT_PADDING}" y="${y}" font-size="${FONT_SIZE}" fill="#CCCCCC" font-family="${FONT_FAMILY}">${escapeXml(line)}</text>
+    `;
+    y += LINE_HEIGHT - 5;
+  }
+
+  return `
+    <svg width="${width}" height="${height}">
+      <rect x="0" y="0" width="${width}" height="${height}" fill="rgba(0,0,0,0.7)"/>
+      ${svgText}
+    </svg>
+  `;
+}
+
+/**
+ * Rasterize an SVG to straight (not premultiplied) RGBA
+ * @returns {Promise<{width: number, height: number, pixels: Buffer}>}
+ */
+async function rasterize(svg) {
+  const { data, info } = await sharp(Buffer.from(svg)).ensureAlpha().raw().toBuffer({ resolveWithObject: true });
+  return { width: info.width, height: info.height, pixels: data };
+}
+
+/**
+ * One line of text on a transparent sprite, cached by text and style; the
+ * least recently used is evicted
+ */
+function label(text, fill, bold = false) {
+  const key = `${fill}|${bold}|${text}`;
+  let sprite = labels.get(key);
+  if (sprite) {
+    labels.delete(key);
+    labels.set(key, sprite);
+  } else {
+    sprite = rasterize(
+      `<svg width="${LABEL_WIDTH}" height="${SPRITE_HEIGHT}" xmlns="http://www.w3.org/2000/svg">` +
+        `<text x="0" y="${SPRITE_BASELINE}" font-size="${FONT_SIZE}"${bold ? ' font-weight="bold"' : ""} fill="${fill}" font-family="${FONT_FAMILY}">${escapeXml(text)}</text>` +
+        `</svg>`,
+    );
+    sprite.catch(() => labels.delete(key));
+    labels.set(key, sprite);
+    if (labels.size > LABEL_CACHE_LIMIT) labels.delete(labels.keys().next().value);
+  }
+  return sprite;
+}
+
+/**
+ * The translucent band, cached per frame size and shared between images, so
+ * never drawn on
+ */
+function band(width, height) {
+  const key = `${width}x${height}`;
+  let pixels = bands.get(key);
+  if (!pixels) {
+    pixels = Buffer.alloc(width * height * 4);
+    for (let i = 3; i < pixels.length; i += 4) pixels[i] = BAND_ALPHA;
+    bands.set(key, pixels);
+    if (bands.size > BAND_CACHE_LIMIT) bands.delete(bands.keys().next().value);
+  }
+  return pixels;
+}
+
+/**
+ * Alpha-blend src over dst with its top-left at (dx, dy)
+ */
+function blit(dst, src, dx, dy) {
+  for (let row = 0; row < src.height; row++) {
+    const y = dy + row;
+    if (y < 0 || y >= dst.height) continue;
+    for (let col = 0; col < src.width; col++) {
+      const x = dx + col;
+      if (x >= dst.width) break;
+      const s = (row * src.width + col) * 4;
+      const a = src.pixels[s + 3];
+      if (a === 0) continue;
+      const d = (y * dst.width + x) * 4;
+      const below = (dst.pixels[d + 3] * (255 - a)) / 255;
+      const outA = a + below;
+      for (let c = 0; c < 3; c++) {
+        dst.pixels[d + c] = Math.round((src.pixels[s + c] * a + dst.pixels[d + c] * below) / outA);
+      }
+      dst.pixels[d + 3] = Math.round(outA);
+    }
+  }
+}
+
+/**
+ * Composite layers for a result's overlay, laid out as overlaySvg() lays it
+ * out: the cached band, then a block with the text, only as large as the text
+ * @param {number} width - Frame width
+ * @param {number} height - Overlay height
+ * @param {object} result - Detection result {package_detected, confidence, description}
+ * @returns {Promise<Array<{input: Buffer, raw: object, top: number, left: number}>>} - For sharp's composite()
+ */
+export async function renderOverlay(width, height, result) {
+  const { decision, decisionColor, confidence } = overlayText(result);
+  const lines = wrapText(result.description || "");
+  const [header, confidenceLabel, ...lineSprites] = await Promise.all([
+    label(decision, decisionColor, true),
+    label(confidence, "#FFFFFF"),
+    ...lines.map((line) => label(line, "#CCCCCC")),
+  ]);
+
+  const blockWidth = Math.min(width, TEXT_PADDING + LABEL_WIDTH);
+  const blockHeight = Math.min(height, TEXT_PADDING + 2 * LINE_HEIGHT + lines.length * (LINE_HEIGHT - 5) + SPRITE_HEIGHT);
+  const block = { width: blockWidth, height: blockHeight, pixels: Buffer.alloc(blockWidth * blockHeight * 4) };
+
+  let y = TEXT_PADDING + LINE_HEIGHT;
+  blit(block, header, TEXT_PADDING, y - SPRITE_BASELINE);
+  y += LINE_HEIGHT;
+  blit(block, confidenceLabel, TEXT_PADDING, y - SPRITE_BASELINE);
+  y += LINE_HEIGHT;
+
+  for (const sprite of lineSprites) {
+    if (y - SPRITE_BASELINE >= blockHeight) break;
+    blit(block, sprite, TEXT_PADDING, y - SPRITE_BASELINE);
+    y += LINE_HEIGHT - 5;
+  }
+
+  return [
+    { input: band(width, height), raw: { width, height, channels: 4 }, top: 0, left: 0 },
+    { input: block.pixels, raw: { width: blockWidth, height: blockHeight, channels: 4 }, top: 0, left: 0 },
+  ];
+}
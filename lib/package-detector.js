@@ -4,7 +4,9 @@ import { GoogleGenerativeAI } from "@google/generative-ai";
 import fs from "fs";
 import path from "path";
 import { logger } from "./logger.js";
-import { cropAndScale, cleanupTemp } from "./image-processor.js";
+import { cropAndScaleFrame, cropAndScaleJpeg } from "./image-processor.js";
+import { noopTrace } from "./tracing.js";
+import { loadLocalClassifier, decideLocally } from "./local-classifier.js";
 
 const MAX_RETRIES = 3;
 const RETRY_DELAY_MS = 1000;
@@ -12,6 +14,26 @@ const RETRY_DELAY_MS = 1000;
 // Model selection from environment
 const MODEL_PROVIDER = process.env.MODEL || "claude";
 
+// Optional first stage: an ONNX classifier answers confident cases locally
+// and only uncertain ones go to the LLM
+const LOCAL_MODEL = process.env.LOCAL_MODEL || "";
+const LOCAL_THRESHOLDS = {
+  low: parseFloat(process.env.LOCAL_MODEL_LOW || "0.15"),
+  high: parseFloat(process.env.LOCAL_MODEL_HIGH || "0.85"),
+};
+let localClassifier = null; // Promise of the loaded classifier, or of null if it failed to load
+
+function getLocalClassifier() {
+  if (!LOCAL_MODEL) return Promise.resolve(null);
+  if (!localClassifier) {
+    localClassifier = loadLocalClassifier(LOCAL_MODEL).catch((error) => {
+      logger.error(`Local classifier disabled: ${error.message}`);
+      return null;
+    });
+  }
+  return localClassifier;
+}
+
 // Initialize clients
 const anthropic = new Anthropic();
 const genAI = process.env.GOOGLE_AI_API_KEY
@@ -133,29 +155,62 @@ async function detectWithGemini(image) {
 /**
  * Detect packages in an image
  * @param {string} imagePath - Path to the captured frame
- * @returns {Promise<{package_detected: boolean, confidence: string, description: string}>}
+ * @param {object} [options]
+ * @param {object} [options.trace] - Trace from createTracer() to record phases in
+ * @param {object} [options.frame] - imagePath already decoded by loadFrame(). Without one,
+ *   only the cropped region is decoded, at reduced scale
+ * @param {Buffer} [options.jpeg] - imagePath's contents, if in memory; the file is not read
+ * @param {Array<[number, number]>|null} [options.roi] - Camera's doorstep polygon (default: bottom band)
+ * @param {boolean} [options.local] - Try the local classifier first, if LOCAL_MODEL is set
+ * @param {boolean} [options.escalate] - Ask the LLM when the local classifier is unsure; if false,
+ *   its best guess is returned at low confidence
+ * @returns {Promise<{package_detected: boolean, confidence: string, description: string,
+ *   source: string, scores?: object}>} - source is "local" or "llm"
  */
-export async function detectPackage(imagePath) {
-  if (!fs.existsSync(imagePath)) {
+export async function detectPackage(
+  imagePath,
+  { trace = noopTrace, frame = null, jpeg = null, roi = null, local = true, escalate = true } = {}
+) {
+  if (!frame && !jpeg && !fs.existsSync(imagePath)) {
     logger.error("Image not found", { path: imagePath });
     throw new Error(`Image not found at ${imagePath}`);
   }
 
   logger.info("Starting package detection", { image: imagePath });
 
-  // Crop and scale image for API call
-  let processedPath = imagePath;
-  let shouldCleanup = false;
+  let scores = null;
+  const classifier = local ? await getLocalClassifier() : null;
+  if (classifier) {
+    try {
+      scores = await trace.span("local_classify", () => classifier.score(frame || jpeg || imagePath, roi));
+      const decided = decideLocally(scores, LOCAL_THRESHOLDS, !escalate);
+      if (decided) {
+        logger.info("Package detection result (local)", { detected: decided.package_detected, scores });
+        return { ...decided, source: "local", scores };
+      }
+      logger.info("Local classifier unsure; asking the LLM", { scores });
+    } catch (error) {
+      logger.warn(`Local classifier failed, asking the LLM: ${error.message}`);
+    }
+  }
+
+  // Crop and scale image for API call, in memory
+  let cropped = null;
 
   try {
-    processedPath = await cropAndScale(imagePath);
-    shouldCleanup = true;
-    logger.info("Cropped and scaled image", { processedPath });
+    cropped = await trace.span("crop_scale", () =>
+      frame ? cropAndScaleFrame(frame, roi) : cropAndScaleJpeg(jpeg || imagePath, roi)
+    );
+    logger.info("Cropped and scaled image", { bytes: cropped.length });
   } catch (e) {
     logger.warn(`Could not crop image, using original: ${e.message}`);
   }
 
-  const image = imageToBase64(processedPath);
+  const base64StartedAt = Date.now();
+  const image = cropped
+    ? { base64: cropped.toString("base64"), mediaType: "image/jpeg" }
+    : imageToBase64(imagePath);
+  trace.record("base64", base64StartedAt, Date.now(), { bytes: image.base64.length });
   const provider = MODEL_PROVIDER.toLowerCase();
 
   let lastError = null;
@@ -166,16 +221,19 @@ export async function detectPackage(imagePath) {
         `Calling ${provider === "gemini" ? "Gemini" : "Anthropic"} API (attempt ${attempt}/${MAX_RETRIES})`
       );
 
-      const responseText =
-        provider === "gemini"
-          ? await detectWithGemini(image)
-          : await detectWithClaude(image);
+      const responseText = await trace.span(
+        "llm_request",
+        () => (provider === "gemini" ? detectWithGemini(image) : detectWithClaude(image)),
+        { provider, attempt }
+      );
 
       logger.info(`Received response from ${provider === "gemini" ? "Gemini" : "Anthropic"}`, {
         rawResponse: responseText,
       });
 
+      const parseStartedAt = Date.now();
       const parsed = parseJsonResponse(responseText);
+      trace.record("json_parse", parseStartedAt, Date.now(), { ok: Boolean(parsed) });
 
       if (!parsed) {
         throw new Error(`Failed to parse JSON response: ${responseText}`);
@@ -187,15 +245,12 @@ export async function detectPackage(imagePath) {
         description: parsed.description,
       });
 
-      // Clean up temp file
-      if (shouldCleanup) {
-        cleanupTemp(processedPath);
-      }
-
       return {
         package_detected: parsed.package_detected === true,
         confidence: parsed.confidence || "unknown",
         description: parsed.description || "",
+        source: "llm",
+        scores: scores || undefined,
       };
     } catch (error) {
       lastError = error;
@@ -210,5 +265,11 @@ export async function detectPackage(imagePath) {
   }
 
   logger.error("All retry attempts failed", { error: lastError?.message });
+
+  // Keep answering while the API is down, from the local scores
+  if (scores) {
+    logger.warn("Falling back to the local classifier's best guess", { scores });
+    return { ...decideLocally(scores, LOCAL_THRESHOLDS, true), source: "local", scores };
+  }
   throw lastError || new Error("Package detection failed after all retries");
 }
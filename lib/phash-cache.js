@@ -0,0 +1,179 @@
+import fs from "fs";
+import { logger } from "./logger.js";
+import { roiSquare } from "./image-processor.js";
+
+// Detection results cached by a perceptual hash (DCT pHash) of the
+// doorstep crop. A frame whose hash is within a small Hamming distance of a
+// cached one reuses that result, so a scene seen before (an empty step, the
+// same package still sitting there) does not cost another LLM call.
+export const HASH_INPUT_SIZE = 32;
+const HASH_BITS_SIZE = 8; // Lowest 8x8 DCT frequencies -> 64 bits
+
+// COSINES[u * N + x] = cos((2x + 1) u pi / 2N)
+const COSINES = new Float64Array(HASH_INPUT_SIZE * HASH_BITS_SIZE);
+for (let u = 0; u < HASH_BITS_SIZE; u++) {
+  for (let x = 0; x < HASH_INPUT_SIZE; x++) {
+    COSINES[u * HASH_INPUT_SIZE + x] = Math.cos(((2 * x + 1) * u * Math.PI) / (2 * HASH_INPUT_SIZE));
+  }
+}
+
+/**
+ * 64-bit pHash of a 32x32 grayscale square: the sign of each of the lowest
+ * 8x8 DCT coefficients relative to their median
+ * @param {{pixels: Uint8Array}} square - From roiSquare(), HASH_INPUT_SIZE on a side
+ * @returns {string} - 16 hex digits
+ */
+export function perceptualHash(square) {
+  const N = HASH_INPUT_SIZE;
+  const K = HASH_BITS_SIZE;
+  const { pixels } = square;
+
+  // Separable DCT, only the K lowest frequencies in each direction
+  const rows = new Float64Array(N * K); // rows[y * K + u]
+  for (let y = 0; y < N; y++) {
+    for (let u = 0; u < K; u++) {
+      let sum = 0;
+      for (let x = 0; x < N; x++) sum += pixels[y * N + x] * COSINES[u * N + x];
+      rows[y * K + u] = sum;
+    }
+  }
+  const coefficients = new Float64Array(K * K); // [v * K + u]
+  for (let v = 0; v < K; v++) {
+    for (let u = 0; u < K; u++) {
+      let sum = 0;
+      for (let y = 0; y < N; y++) sum += rows[y * K + u] * COSINES[v * N + y];
+      coefficients[v * K + u] = sum;
+    }
+  }
+
+  // The DC term is overall brightness; leave it out of the median, which
+  // is then the middle of 63 values
+  const sorted = Array.from(coefficients.subarray(1)).sort((a, b) => a - b);
+  const median = sorted[31];
+
+  let hi = 0;
+  let lo = 0;
+  for (let i = 0; i < 32; i++) {
+    if (coefficients[i] > median) hi |= 1 << (31 - i);
+    if (coefficients[32 + i] > median) lo |= 1 << (31 - i);
+  }
+  return (hi >>> 0).toString(16).padStart(8, "0") + (lo >>> 0).toString(16).padStart(8, "0");
+}
+
+function popcount(n) {
+  n = n - ((n >>> 1) & 0x55555555);
+  n = (n & 0x33333333) + ((n >>> 2) & 0x33333333);
+  return (((n + (n >>> 4)) & 0x0f0f0f0f) * 0x01010101) >>> 24;
+}
+
+/**
+ * Number of differing bits between two hashes from perceptualHash()
+ */
+export function hammingDistance(a, b) {
+  return (
+    popcount((parseInt(a.slice(0, 8), 16) ^ parseInt(b.slice(0, 8), 16)) >>> 0) +
+    popcount((parseInt(a.slice(8), 16) ^ parseInt(b.slice(8), 16)) >>> 0)
+  );
+}
+
+/**
+ * LRU cache of detection results, persisted so it survives restarts
+ * @param {object} options
+ * @param {string} options.stateFile - JSON file the cache is saved to
+ * @param {number} options.capacity - Entries kept, least recently used evicted first
+ * @param {number} options.ttlMs - Entries older than this are never reused
+ * @param {number} options.maxDistance - Hamming distance that still counts as the same scene
+ * @param {object} options.metrics - Registry from createMetrics()
+ */
+export function createPhashCache({ stateFile, capacity, ttlMs, maxDistance, metrics }) {
+  // camera key + hash -> {camera, hash, detection, at}; Map order is LRU order
+  const entries = load();
+
+  function load() {
+    const loaded = new Map();
+    try {
+      if (!fs.existsSync(stateFile)) return loaded;
+      const now = Date.now();
+      for (const entry of JSON.parse(fs.readFileSync(stateFile, "utf-8"))) {
+        if (now - entry.at <= ttlMs) loaded.set(`${entry.camera}:${entry.hash}`, entry);
+      }
+      logger.info("Loaded detection cache", { entries: loaded.size });
+    } catch (error) {
+      logger.warn(`Could not load detection cache, starting empty: ${error.message}`);
+    }
+    return loaded;
+  }
+
+  function save() {
+    try {
+      fs.writeFileSync(`${stateFile}.tmp`, JSON.stringify([...entries.values()]));
+      fs.renameSync(`${stateFile}.tmp`, stateFile);
+    } catch (error) {
+      logger.warn(`Could not save detection cache: ${error.message}`);
+    }
+  }
+
+  /**
+   * @param {string|Buffer} input - JPEG path or contents
+   * @param {Array<[number, number]>|null} [roi] - Doorstep polygon, see roiSquare()
+   * @returns {Promise<string>} - Hash of the frame's doorstep crop
+   */
+  async function thumbnail(input, roi = null) {
+    return perceptualHash(await roiSquare(input, HASH_INPUT_SIZE, roi));
+  }
+
+  /**
+   * @param {string} cameraKey
+   * @param {string} hash - From thumbnail()
+   * @returns {{reuse: object|null, sample: string, distance?: number}} - reuse is the cached
+   *   detection of the nearest hash within maxDistance; sample is for remember()
+   */
+  function check(cameraKey, hash) {
+    const now = Date.now();
+    let best = null;
+    let bestDistance = Infinity;
+    for (const [key, entry] of entries) {
+      if (now - entry.at > ttlMs) {
+        entries.delete(key);
+        continue;
+      }
+      if (entry.camera !== cameraKey) continue;
+      const distance = hammingDistance(hash, entry.hash);
+      if (distance < bestDistance) {
+        best = entry;
+        bestDistance = distance;
+      }
+    }
+
+    if (!best || bestDistance > maxDistance) {
+      metrics.increment("phash_cache_miss");
+      logger.debug("Detection cache miss", { camera: cameraKey, hash, nearest: best ? bestDistance : undefined });
+      return { reuse: null, sample: hash };
+    }
+
+    // Move to the most recently used end
+    const key = `${best.camera}:${best.hash}`;
+    entries.delete(key);
+    entries.set(key, best);
+    metrics.increment("phash_cache_hit");
+    return { reuse: best.detection, sample: hash, distance: bestDistance };
+  }
+
+  /**
+   * Cache the LLM result for a frame
+   * @param {string} cameraKey
+   * @param {{sample: string}} checked - check() result for that frame
+   * @param {object} detection
+   */
+  function remember(cameraKey, { sample: hash }, detection) {
+    const key = `${cameraKey}:${hash}`;
+    entries.delete(key);
+    entries.set(key, { camera: cameraKey, hash, detection, at: Date.now() });
+    while (entries.size > capacity) {
+      entries.delete(entries.keys().next().value);
+    }
+    save();
+  }
+
+  return { thumbnail, check, remember };
+}
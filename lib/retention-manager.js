@@ -0,0 +1,183 @@
+import fs from "fs";
+import path from "path";
+import { logger } from "./logger.js";
+
+// Expires captured files without walking the directories on every capture.
+// Writers report each file as they write it; the manager keeps them in an
+// in-memory index ordered by write time and deletes from the old end in the
+// background, whenever a file is past the age limit or the total is over the
+// size quota. The directories are only listed once, asynchronously, at
+// startup, to pick up files written before this process.
+const EXPIRY_INTERVAL_MS = 60 * 1000;
+
+/**
+ * @param {object} options
+ * @param {string} options.root - Directory whose subdirectories are managed (one level deep)
+ * @param {string[]} options.excludeDirs - Subdirectories that expire their own files
+ * @param {number} options.maxAgeMs - Files older than this are deleted
+ * @param {number} options.maxBytes - Oldest files are deleted while the total is above this; 0 for no quota
+ * @param {object} options.metrics - Registry from createMetrics()
+ */
+export function createRetentionManager({ root, excludeDirs, maxAgeMs, maxBytes, metrics }) {
+  const rootPath = path.resolve(root);
+  const excluded = excludeDirs.map((dir) => path.join(rootPath, dir) + path.sep);
+
+  // {path, bytes, at}, oldest first from entries[head]
+  let entries = [];
+  let head = 0;
+  const tracked = new Set();
+  let totalBytes = 0;
+  let expiring = null;
+
+  const expiryTimer = setInterval(() => expire(), EXPIRY_INTERVAL_MS);
+  expiryTimer.unref();
+
+  function managed(filePath) {
+    const resolved = path.resolve(filePath);
+    return resolved.startsWith(rootPath + path.sep) && !excluded.some((dir) => resolved.startsWith(dir));
+  }
+
+  function add(entry) {
+    tracked.add(entry.path);
+    totalBytes += entry.bytes;
+    if (entries.length === head || entries[entries.length - 1].at <= entry.at) {
+      entries.push(entry);
+      return;
+    }
+    // Out of order (a slow stat); binary search from the old end
+    let lo = head;
+    let hi = entries.length;
+    while (lo < hi) {
+      const mid = (lo + hi) >>> 1;
+      if (entries[mid].at <= entry.at) lo = mid + 1;
+      else hi = mid;
+    }
+    entries.splice(lo, 0, entry);
+  }
+
+  /**
+   * Record a file just written
+   * @param {string} filePath
+   * @param {number|null} [bytes] - Size, if known; otherwise the file is stat'ed (asynchronously)
+   */
+  function track(filePath, bytes = null) {
+    if (!managed(filePath)) return;
+    const resolved = path.resolve(filePath);
+    if (tracked.has(resolved)) return;
+    const at = Date.now();
+
+    const added =
+      bytes !== null
+        ? Promise.resolve(add({ path: resolved, bytes, at }))
+        : fs.promises.stat(resolved).then(
+            (stats) => {
+              if (!tracked.has(resolved)) add({ path: resolved, bytes: stats.size, at });
+            },
+            () => {} // Already gone
+          );
+    if (maxBytes > 0) added.then(() => totalBytes > maxBytes && expire());
+  }
+
+  /**
+   * List the managed directories once, in the background, and merge files
+   * not already tracked into the index by modification time
+   * @returns {Promise<number>} - Files found
+   */
+  async function scan() {
+    const found = [];
+    let subdirs = [];
+    try {
+      subdirs = (await fs.promises.readdir(rootPath, { withFileTypes: true }))
+        .filter((d) => d.isDirectory() && !excludeDirs.includes(d.name))
+        .map((d) => path.join(rootPath, d.name));
+    } catch (error) {
+      if (error.code !== "ENOENT") logger.warn(`Could not list ${rootPath}: ${error.message}`);
+      return 0;
+    }
+
+    for (const subdir of subdirs) {
+      for (const name of await fs.promises.readdir(subdir)) {
+        const filePath = path.join(subdir, name);
+        try {
+          const stats = await fs.promises.stat(filePath);
+          if (stats.isFile()) found.push({ path: filePath, bytes: stats.size, at: stats.mtimeMs });
+        } catch {
+          // Deleted while listing
+        }
+      }
+    }
+
+    // Merge the sorted scan into the index in one pass
+    const fresh = found.filter((entry) => !tracked.has(entry.path)).sort((a, b) => a.at - b.at);
+    const current = entries.slice(head);
+    const merged = [];
+    let i = 0;
+    let j = 0;
+    while (i < fresh.length || j < current.length) {
+      if (j >= current.length || (i < fresh.length && fresh[i].at <= current[j].at)) merged.push(fresh[i++]);
+      else merged.push(current[j++]);
+    }
+    for (const entry of fresh) {
+      tracked.add(entry.path);
+      totalBytes += entry.bytes;
+    }
+    entries = merged;
+    head = 0;
+
+    logger.info("Retention index built", { files: entries.length, mb: Math.round(totalBytes / 1024 ** 2) });
+    expire();
+    return fresh.length;
+  }
+
+  async function runExpiry() {
+    const cutoff = Date.now() - maxAgeMs;
+    let deleted = 0;
+    let freedBytes = 0;
+    while (head < entries.length && (entries[head].at < cutoff || (maxBytes > 0 && totalBytes > maxBytes))) {
+      const entry = entries[head++];
+      tracked.delete(entry.path);
+      totalBytes -= entry.bytes;
+      try {
+        await fs.promises.unlink(entry.path);
+        deleted++;
+        freedBytes += entry.bytes;
+      } catch (error) {
+        if (error.code !== "ENOENT") logger.warn(`Could not delete ${entry.path}: ${error.message}`);
+      }
+    }
+
+    // Drop the consumed prefix once it is most of the array
+    if (head > 1024 && head * 2 > entries.length) {
+      entries = entries.slice(head);
+      head = 0;
+    }
+
+    if (deleted > 0) {
+      metrics.increment("retention_files_deleted", deleted);
+      logger.info(`Expired ${deleted} captured files`, { mb: Math.round(freedBytes / 1024 ** 2) });
+    }
+  }
+
+  /**
+   * Delete expired files from the old end of the index. Runs every minute
+   * on its own; calls while a pass is running share it.
+   * @returns {Promise<void>}
+   */
+  function expire() {
+    if (!expiring) {
+      expiring = runExpiry()
+        .catch((error) => logger.warn(`Retention pass failed: ${error.message}`))
+        .finally(() => {
+          expiring = null;
+        });
+    }
+    return expiring;
+  }
+
+  return {
+    track,
+    scan,
+    expire,
+    stats: () => ({ files: entries.length - head, bytes: totalBytes }),
+  };
+}
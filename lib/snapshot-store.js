@@ -0,0 +1,266 @@
+import fs from "fs";
+import path from "path";
+import crypto from "crypto";
+import { logger } from "./logger.js";
+import { roiSquare } from "./image-processor.js";
+import { HASH_INPUT_SIZE, perceptualHash, hammingDistance } from "./phash-cache.js";
+
+// Captured frames stored by content rather than by name and time. Each JPEG
+// is a blob named after its SHA-256, under a two-hex-digit shard directory,
+// so identical frames are written once. Optionally, a frame whose doorstep
+// region has a perceptual hash close to a recent blob's from the same camera
+// is not written at all and refers to that blob instead, so a static
+// doorstep adds index lines rather than files.
+//
+// index.jsonl is append-only, one line per stored frame or detection:
+//   {"t": ms, "cam": key, "frame": id, "hash": blob, "phash"?: hex, "near"?: distance, "result"?: {...}}
+// Every stored frame gets its own id, even when it shares a blob. "near"
+// marks a frame kept only as a reference to an earlier blob. Lines with
+// "result" record a detection on that frame. The index is rewritten without
+// expired lines when the store is pruned.
+const HASH_LENGTH = 32; // Hex digits of the SHA-256 kept; 128 bits
+const RECENT_BLOBS_PER_CAMERA = 16; // Candidates for a near-duplicate match
+const PRUNE_INTERVAL_MS = 60 * 60 * 1000;
+
+/**
+ * Open (or create) a snapshot store
+ * @param {object} options
+ * @param {string} options.dir - Holds blobs/, annotated/ and index.jsonl
+ * @param {number} options.maxAgeMs - Blobs not referenced for this long are deleted
+ * @param {number} options.nearDuplicateDistance - pHash Hamming distance within which a
+ *   frame refers to an earlier blob; negative to store every distinct frame
+ * @param {object} options.metrics - Registry from createMetrics()
+ */
+export function createSnapshotStore({ dir, maxAgeMs, nearDuplicateDistance, metrics }) {
+  const blobsDir = path.join(dir, "blobs");
+  const annotatedDir = path.join(dir, "annotated");
+  const indexPath = path.join(dir, "index.jsonl");
+  for (const d of [blobsDir, annotatedDir]) {
+    if (!fs.existsSync(d)) fs.mkdirSync(d, { recursive: true });
+  }
+
+  const entries = []; // Index lines, oldest first
+  const blobs = new Map(); // hash -> {camera, lastSeen}
+  const recent = new Map(); // camera key -> [{hash, phash}], newest last
+  const shards = new Set(); // Shard directories known to exist
+  let indexChain = Promise.resolve();
+  let nextFrameId = 1;
+  let pruning = null;
+
+  load();
+  // Once now, so runs shorter than the interval (one-shot, frequent
+  // restarts) still expire blobs, then hourly
+  prune();
+  const pruneTimer = setInterval(() => prune(), PRUNE_INTERVAL_MS);
+  pruneTimer.unref();
+
+  function load() {
+    if (!fs.existsSync(indexPath)) return;
+    let skipped = 0;
+    for (const line of fs.readFileSync(indexPath, "utf-8").split("\n")) {
+      if (!line) continue;
+      let entry;
+      try {
+        entry = JSON.parse(line);
+      } catch {
+        skipped++; // A line cut short by a crash
+        continue;
+      }
+      entries.push(entry);
+      touch(entry.hash, entry.cam, entry.t);
+      if (entry.phash) remember(entry.cam, entry.hash, entry.phash);
+      if (entry.frame >= nextFrameId) nextFrameId = entry.frame + 1;
+    }
+    logger.info("Loaded snapshot store index", { entries: entries.length, blobs: blobs.size, skipped });
+  }
+
+  function touch(hash, camera, at) {
+    const blob = blobs.get(hash);
+    if (blob) blob.lastSeen = Math.max(blob.lastSeen, at);
+    else blobs.set(hash, { camera, lastSeen: at });
+  }
+
+  function remember(camera, hash, phash) {
+    const list = recent.get(camera) || [];
+    list.push({ hash, phash });
+    if (list.length > RECENT_BLOBS_PER_CAMERA) list.shift();
+    recent.set(camera, list);
+  }
+
+  function append(entry) {
+    entries.push(entry);
+    touch(entry.hash, entry.cam, entry.t);
+    const line = JSON.stringify(entry) + "\n";
+    indexChain = indexChain
+      .then(() => fs.promises.appendFile(indexPath, line))
+      .catch((error) => logger.warn(`Could not append to snapshot index: ${error.message}`));
+    return indexChain;
+  }
+
+  /**
+   * @param {string} hash
+   * @returns {string} - Path of the blob
+   */
+  function blobPath(hash) {
+    return path.join(blobsDir, hash.slice(0, 2), `${hash}.jpg`);
+  }
+
+  /**
+   * Where the annotated image of a stored frame goes. Keyed by the frame,
+   * not the blob: frames sharing a blob can have different results.
+   * @param {number} frameId - From put()
+   * @returns {string}
+   */
+  function annotatedPath(frameId) {
+    return path.join(annotatedDir, `${frameId}.jpg`);
+  }
+
+  async function writeBlob(hash, jpeg) {
+    const shard = path.join(blobsDir, hash.slice(0, 2));
+    if (!shards.has(shard)) {
+      await fs.promises.mkdir(shard, { recursive: true });
+      shards.add(shard);
+    }
+    // Written under another name and renamed, so a blob is never half there
+    const target = blobPath(hash);
+    await fs.promises.writeFile(`${target}.tmp`, jpeg);
+    await fs.promises.rename(`${target}.tmp`, target);
+  }
+
+  /**
+   * Store a captured frame
+   * @param {string} cameraKey
+   * @param {Buffer} jpeg
+   * @param {Array<[number, number]>|null} [roi] - Camera's doorstep polygon; near duplicates
+   *   are judged on this region only, so a package appearing there is never deduplicated away
+   * @returns {Promise<{frame: number, hash: string, path: string, near?: number}>} - The frame's
+   *   id and the blob now holding it; near is set when it is an earlier, near-identical frame's blob
+   */
+  async function put(cameraKey, jpeg, roi = null) {
+    const at = Date.now();
+    const frame = nextFrameId++;
+    const hash = crypto.createHash("sha256").update(jpeg).digest("hex").slice(0, HASH_LENGTH);
+
+    if (blobs.has(hash)) {
+      metrics.increment("snapshot_duplicates");
+      append({ t: at, cam: cameraKey, frame, hash });
+      return { frame, hash, path: blobPath(hash) };
+    }
+
+    let phash;
+    if (nearDuplicateDistance >= 0) {
+      phash = perceptualHash(await roiSquare(jpeg, HASH_INPUT_SIZE, roi));
+      let nearest = null;
+      let nearestDistance = Infinity;
+      for (const candidate of recent.get(cameraKey) || []) {
+        const distance = hammingDistance(phash, candidate.phash);
+        if (distance < nearestDistance && blobs.has(candidate.hash)) {
+          nearest = candidate;
+          nearestDistance = distance;
+        }
+      }
+      if (nearest && nearestDistance <= nearDuplicateDistance) {
+        metrics.increment("snapshot_near_duplicates");
+        append({ t: at, cam: cameraKey, frame, hash: nearest.hash, near: nearestDistance });
+        return { frame, hash: nearest.hash, path: blobPath(nearest.hash), near: nearestDistance };
+      }
+    }
+
+    // Claimed before the write so a concurrent put of the same frame does not write it again
+    blobs.set(hash, { camera: cameraKey, lastSeen: at });
+    try {
+      await writeBlob(hash, jpeg);
+    } catch (error) {
+      blobs.delete(hash);
+      throw error;
+    }
+    if (phash) remember(cameraKey, hash, phash);
+    metrics.increment("snapshot_blobs_written");
+    append({ t: at, cam: cameraKey, frame, hash, phash });
+    return { frame, hash, path: blobPath(hash) };
+  }
+
+  /**
+   * Record the detection result for a stored frame
+   * @param {string} cameraKey
+   * @param {{frame: number, hash: string}} stored - From put()
+   * @param {object} result - Detection result; the description is not kept
+   */
+  function record(cameraKey, { frame, hash }, result) {
+    return append({
+      t: Date.now(),
+      cam: cameraKey,
+      frame,
+      hash,
+      result: { package_detected: result.package_detected, confidence: result.confidence, source: result.source },
+    });
+  }
+
+  async function unlinkIfPresent(filePath) {
+    try {
+      await fs.promises.unlink(filePath);
+    } catch (error) {
+      if (error.code !== "ENOENT") throw error;
+    }
+  }
+
+  /**
+   * Delete blobs not referenced within maxAgeMs, and the annotated images of
+   * frames older than that, and rewrite the index without their lines. Runs
+   * when the store is opened and hourly after that; calls while a pass is
+   * running share it.
+   * @returns {Promise<void>}
+   */
+  function prune() {
+    if (!pruning) {
+      pruning = runPrune()
+        .catch((error) => logger.warn(`Snapshot store prune failed: ${error.message}`))
+        .finally(() => {
+          pruning = null;
+        });
+    }
+    return pruning;
+  }
+
+  async function runPrune() {
+    const cutoff = Date.now() - maxAgeMs;
+    const expired = [...blobs].filter(([, blob]) => blob.lastSeen < cutoff).map(([hash]) => hash);
+    for (const hash of expired) blobs.delete(hash);
+    for (const [camera, list] of recent) {
+      recent.set(camera, list.filter((candidate) => blobs.has(candidate.hash)));
+    }
+
+    for (const hash of expired) {
+      try {
+        await unlinkIfPresent(blobPath(hash));
+      } catch (error) {
+        logger.warn(`Could not delete snapshot blob ${hash}: ${error.message}`);
+      }
+    }
+
+    const kept = entries.filter((entry) => entry.t >= cutoff);
+    if (kept.length === entries.length) return;
+    for (const entry of entries) {
+      if (entry.t >= cutoff || entry.result || entry.frame === undefined) continue;
+      try {
+        await unlinkIfPresent(annotatedPath(entry.frame));
+      } catch (error) {
+        logger.warn(`Could not delete annotated image of frame ${entry.frame}: ${error.message}`);
+      }
+    }
+    entries.splice(0, entries.length, ...kept);
+    // Queued with the appends: those already queued are in this snapshot and
+    // those queued later go to the new file
+    const contents = entries.map((entry) => JSON.stringify(entry) + "\n").join("");
+    indexChain = indexChain
+      .then(async () => {
+        await fs.promises.writeFile(`${indexPath}.tmp`, contents);
+        await fs.promises.rename(`${indexPath}.tmp`, indexPath);
+      })
+      .catch((error) => logger.warn(`Could not rewrite snapshot index: ${error.message}`));
+    await indexChain;
+    logger.info("Pruned snapshot store", { blobsDeleted: expired.length, entries: entries.length });
+  }
+
+  return { put, record, annotatedPath, prune };
+}
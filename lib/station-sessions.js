@@ -0,0 +1,109 @@
+import { logger } from "./logger.js";
+
+const STATION_CONNECT_TIMEOUT_MS = 15 * 1000;
+
+/**
+ * Open station P2P sessions ahead of livestream commands, so the P2P setup
+ * is timed on its own, and optionally hold them open between captures.
+ *
+ * @param {() => EufySecurity|null} getClient - Current client, or null while it is unusable
+ * @param {object} options
+ * @param {number} options.keepWarmIntervalMs - How often keepWarm() re-opens dropped sessions
+ * @param {object} options.metrics - Registry from createMetrics()
+ */
+export function createStationSessions(getClient, { keepWarmIntervalMs, metrics }) {
+  const connecting = new Map(); // station serial -> in-flight connect
+  let keepWarmTimer = null;
+
+  async function isConnected(client, stationSerial) {
+    try {
+      return Boolean(await client.isStationConnected(stationSerial));
+    } catch {
+      return false;
+    }
+  }
+
+  function waitForConnect(client, stationSerial) {
+    return new Promise((resolve, reject) => {
+      const timer = setTimeout(() => {
+        client.removeListener("station connect", onConnect);
+        reject(new Error(`Station ${stationSerial} P2P connect timed out`));
+      }, STATION_CONNECT_TIMEOUT_MS);
+
+      function onConnect(station) {
+        if (station.getSerial() !== stationSerial) return;
+        clearTimeout(timer);
+        client.removeListener("station connect", onConnect);
+        resolve();
+      }
+      client.on("station connect", onConnect);
+    });
+  }
+
+  async function connect(client, stationSerial) {
+    const startedAt = Date.now();
+    await Promise.all([
+      waitForConnect(client, stationSerial),
+      client.connectToStation(stationSerial),
+    ]);
+    const connectMs = Date.now() - startedAt;
+    metrics.observe("livestream_p2p_connect_ms", connectMs);
+    logger.debug("Station P2P session open", { station: stationSerial, connectMs });
+    return connectMs;
+  }
+
+  /**
+   * Make sure the station's P2P session is open
+   * @param {string} stationSerial
+   * @returns {Promise<{warm: boolean, connectMs: number}>} - warm if it was already open
+   */
+  async function ensureConnected(stationSerial) {
+    const client = getClient();
+    if (!client) throw new Error("Eufy client not connected");
+    if (await isConnected(client, stationSerial)) {
+      return { warm: true, connectMs: 0 };
+    }
+
+    // A keep-warm tick and a capture can ask for the same station at once
+    if (!connecting.has(stationSerial)) {
+      connecting.set(
+        stationSerial,
+        connect(client, stationSerial).finally(() => connecting.delete(stationSerial))
+      );
+    }
+    const connectMs = await connecting.get(stationSerial);
+    return { warm: false, connectMs };
+  }
+
+  /**
+   * Re-open sessions that dropped, every keepWarmIntervalMs. The client
+   * sends its own P2P heartbeats while a session is open.
+   * @param {() => string[]} getStationSerials - Stations to keep open
+   */
+  function keepWarm(getStationSerials) {
+    clearInterval(keepWarmTimer);
+
+    async function tick() {
+      const client = getClient();
+      if (!client) return;
+      for (const stationSerial of new Set(getStationSerials())) {
+        if (connecting.has(stationSerial) || (await isConnected(client, stationSerial))) continue;
+        metrics.increment("keep_warm_reconnects");
+        logger.info("Re-opening station P2P session", { station: stationSerial });
+        ensureConnected(stationSerial).catch((error) => {
+          logger.warn("Keep-warm connect failed", { station: stationSerial, error: error.message });
+        });
+      }
+    }
+
+    keepWarmTimer = setInterval(tick, keepWarmIntervalMs);
+    tick();
+  }
+
+  function stop() {
+    clearInterval(keepWarmTimer);
+    keepWarmTimer = null;
+  }
+
+  return { ensureConnected, keepWarm, stop };
+}
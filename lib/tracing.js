@@ -0,0 +1,150 @@
+import fs from "fs";
+import path from "path";
+import crypto from "crypto";
+import { logger } from "./logger.js";
+
+// Spans for the capture-to-LED pipeline, one JSON line each, appended to
+// data/traces-<service>.jsonl. A trace crosses from capture.js to the
+// server inside the package_exists payload as {traceId, spanId}.
+const DATA_DIR = "./data";
+const MAX_TRACE_FILE_BYTES = 10 * 1024 * 1024; // Rotated to .1 beyond this
+
+function newId(bytes) {
+  return crypto.randomBytes(bytes).toString("hex");
+}
+
+/**
+ * Trace that records nothing, for callers that were not given one
+ */
+export const noopTrace = {
+  traceId: null,
+  span: (name, fn) => fn(null),
+  record: () => {},
+  end: () => {},
+};
+
+/**
+ * Trace that keeps its spans in memory, for code running in a worker
+ * thread; the main thread replays them into its own trace with record().
+ * @returns {{span: Function, record: Function, spans: object[]}}
+ */
+export function createRecordingTrace() {
+  const spans = [];
+
+  function record(name, startMs, endMs, attrs = {}) {
+    spans.push({ name, startMs, endMs, attrs });
+  }
+
+  async function span(name, fn, attrs = {}) {
+    const startMs = Date.now();
+    try {
+      return await fn(null);
+    } catch (error) {
+      attrs = { ...attrs, error: error.message };
+      throw error;
+    } finally {
+      record(name, startMs, Date.now(), attrs);
+    }
+  }
+
+  return { traceId: null, span, record, end: () => {}, spans };
+}
+
+/**
+ * Create a tracer for one process
+ * @param {string} service - Span source, also names the trace file
+ * @param {object} [options]
+ * @param {string} [options.dataDir] - Directory for the trace file
+ * @param {object} [options.metrics] - Registry from createMetrics(); each span
+ *   is also observed as span_<name>_ms for p50/p95/p99 summaries
+ */
+export function createTracer(service, { dataDir = DATA_DIR, metrics = null } = {}) {
+  const filePath = path.join(dataDir, `traces-${service}.jsonl`);
+  let pending = [];
+  let writeScheduled = false;
+
+  function flushPending() {
+    writeScheduled = false;
+    const lines = pending.join("");
+    pending = [];
+    try {
+      if (!fs.existsSync(dataDir)) {
+        fs.mkdirSync(dataDir, { recursive: true });
+      }
+      if (fs.existsSync(filePath) && fs.statSync(filePath).size > MAX_TRACE_FILE_BYTES) {
+        fs.renameSync(filePath, `${filePath}.1`);
+      }
+      fs.appendFileSync(filePath, lines);
+    } catch (error) {
+      logger.warn(`Could not write traces: ${error.message}`);
+    }
+  }
+
+  function exportSpan(span) {
+    metrics?.observe(`span_${span.name}_ms`, span.durationMs);
+    pending.push(`${JSON.stringify(span)}\n`);
+    // Batch the spans of one tick into a single append
+    if (!writeScheduled) {
+      writeScheduled = true;
+      setImmediate(flushPending);
+    }
+  }
+
+  /**
+   * Start a trace, or continue one from another process
+   * @param {string} rootName - Name of the span covering the whole trace
+   * @param {object} [attrs] - Attributes for the root span
+   * @param {{traceId: string, spanId: string}} [parent] - Propagated context
+   */
+  function startTrace(rootName, attrs = {}, parent = null) {
+    const traceId = parent?.traceId || newId(16);
+    const rootId = newId(8);
+    const startMs = Date.now();
+
+    function record(name, spanStartMs, spanEndMs, spanAttrs = {}, spanId = newId(8)) {
+      exportSpan({
+        traceId,
+        spanId,
+        parentId: rootId,
+        service,
+        name,
+        startMs: spanStartMs,
+        durationMs: spanEndMs - spanStartMs,
+        ...(Object.keys(spanAttrs).length ? { attrs: spanAttrs } : {}),
+      });
+    }
+
+    /**
+     * Time an async step. fn gets the span's context to propagate.
+     */
+    async function span(name, fn, spanAttrs = {}) {
+      const spanId = newId(8);
+      const spanStartMs = Date.now();
+      try {
+        return await fn({ traceId, spanId });
+      } catch (error) {
+        spanAttrs = { ...spanAttrs, error: error.message };
+        throw error;
+      } finally {
+        record(name, spanStartMs, Date.now(), spanAttrs, spanId);
+      }
+    }
+
+    function end(endAttrs = {}) {
+      exportSpan({
+        traceId,
+        spanId: rootId,
+        parentId: parent?.spanId || null,
+        service,
+        name: rootName,
+        startMs,
+        durationMs: Date.now() - startMs,
+        attrs: { ...attrs, ...endAttrs },
+      });
+    }
+
+    return { traceId, span, record, end };
+  }
+
+  return { startTrace, filePath };
+}
@@ -0,0 +1,251 @@
+import fs from "fs";
+import path from "path";
+import { logger } from "./logger.js";
+import { findKeyframeOffset } from "./h26x.js";
+
+// Raw elementary stream from every capture goes into one fixed-size file,
+// written sequentially and wrapping around, instead of one file per capture.
+// Offsets in the index are logical (monotonic across wraps); the physical
+// position is logical % capacity. A record is dropped from the index as soon
+// as the write head overwrites any part of it.
+const SEGMENT_SIZE = 64 * 1024 * 1024;
+const INDEX_VERSION = 1;
+
+/**
+ * Read a record's bytes from an open ring file
+ */
+function readExtents(fd, capacity, record) {
+  const parts = [];
+  for (const extent of record.extents) {
+    const buffer = Buffer.alloc(extent.length);
+    const physical = extent.offset % capacity;
+    const firstPart = Math.min(extent.length, capacity - physical);
+    fs.readSync(fd, buffer, 0, firstPart, physical);
+    if (firstPart < extent.length) {
+      fs.readSync(fd, buffer, firstPart, extent.length - firstPart, 0);
+    }
+    parts.push(buffer);
+  }
+  return Buffer.concat(parts);
+}
+
+/**
+ * Open an existing ring read-only, with the geometry recorded in its index,
+ * for tools that run next to the capture service. Never resizes, truncates
+ * or rewrites anything.
+ * @param {string} dir - Directory holding ring.bin and index.json
+ * @returns {{readRecord: (id: number) => Buffer|null, records: (serial?: string) => object[],
+ *   close: () => void, capacity: number}}
+ */
+export function openVideoRingReader(dir) {
+  const index = JSON.parse(fs.readFileSync(path.join(dir, "index.json"), "utf-8"));
+  if (index.version !== INDEX_VERSION) {
+    throw new Error(`Unsupported video ring index version ${index.version}`);
+  }
+  const { capacity } = index;
+  const fd = fs.openSync(path.join(dir, "ring.bin"), "r");
+  if (fs.fstatSync(fd).size !== capacity) {
+    fs.closeSync(fd);
+    throw new Error(`ring.bin is not the ${capacity} bytes its index describes`);
+  }
+
+  function readRecord(id) {
+    const record = index.records.find((r) => r.id === id);
+    return record ? readExtents(fd, capacity, record) : null;
+  }
+
+  function records(serial) {
+    return index.records.filter((r) => !serial || r.serial === serial);
+  }
+
+  return { readRecord, records, close: () => fs.closeSync(fd), capacity };
+}
+
+/**
+ * Open (or create) a ring store
+ * @param {string} dir - Directory holding ring.bin and index.json
+ * @param {number} capacityBytes - Rounded down to whole segments
+ */
+export function openVideoRingStore(dir, capacityBytes) {
+  const segmentCount = Math.max(1, Math.floor(capacityBytes / SEGMENT_SIZE));
+  const capacity = segmentCount * SEGMENT_SIZE;
+  const ringPath = path.join(dir, "ring.bin");
+  const indexPath = path.join(dir, "index.json");
+
+  if (!fs.existsSync(dir)) {
+    fs.mkdirSync(dir, { recursive: true });
+  }
+
+  let index = loadIndex();
+  const fd = fs.openSync(ringPath, fs.existsSync(ringPath) ? "r+" : "w+");
+  if (fs.fstatSync(fd).size !== capacity) {
+    // Fixed size up front so disk usage never grows past the capacity
+    fs.ftruncateSync(fd, capacity);
+  }
+
+  let writeChain = Promise.resolve();
+  let nextRecordId = index.records.reduce((max, r) => Math.max(max, r.id), 0) + 1;
+
+  function emptyIndex() {
+    return {
+      version: INDEX_VERSION,
+      capacity,
+      segmentSize: SEGMENT_SIZE,
+      head: 0,
+      segments: new Array(segmentCount).fill(null),
+      records: [],
+    };
+  }
+
+  function loadIndex() {
+    try {
+      const loaded = JSON.parse(fs.readFileSync(indexPath, "utf-8"));
+      if (loaded.version === INDEX_VERSION && loaded.capacity === capacity) {
+        return loaded;
+      }
+      logger.warn("Video ring geometry changed; starting a new ring", {
+        was: loaded.capacity,
+        now: capacity,
+      });
+    } catch (error) {
+      if (error.code !== "ENOENT") {
+        logger.warn(`Could not read video ring index, starting a new ring: ${error.message}`);
+      }
+    }
+    return emptyIndex();
+  }
+
+  function saveIndex() {
+    const tmpPath = `${indexPath}.tmp`;
+    fs.writeFileSync(tmpPath, JSON.stringify(index));
+    fs.renameSync(tmpPath, indexPath);
+  }
+
+  /**
+   * Reserve `length` bytes at the write head and evict records it overwrites
+   * @returns {number} - Logical offset of the reservation
+   */
+  function allocate(length, at) {
+    const offset = index.head;
+    index.head += length;
+
+    const oldestValid = index.head - capacity;
+    index.records = index.records.filter((r) => r.extents.every((e) => e.offset >= oldestValid));
+
+    const firstSegment = Math.floor(offset / SEGMENT_SIZE);
+    const lastSegment = Math.floor((index.head - 1) / SEGMENT_SIZE);
+    for (let seg = firstSegment; seg <= lastSegment; seg++) {
+      const slot = seg % segmentCount;
+      const current = index.segments[slot];
+      if (!current || current.logicalStart !== seg * SEGMENT_SIZE) {
+        index.segments[slot] = { logicalStart: seg * SEGMENT_SIZE, firstAt: at, lastAt: at };
+      } else {
+        current.lastAt = at;
+      }
+    }
+    return offset;
+  }
+
+  async function writeAt(logical, chunk) {
+    const physical = logical % capacity;
+    const firstPart = Math.min(chunk.length, capacity - physical);
+    await writeFully(chunk.subarray(0, firstPart), physical);
+    if (firstPart < chunk.length) {
+      await writeFully(chunk.subarray(firstPart), 0);
+    }
+  }
+
+  function writeFully(buffer, position) {
+    return new Promise((resolve, reject) => {
+      fs.write(fd, buffer, 0, buffer.length, position, (err) => (err ? reject(err) : resolve()));
+    });
+  }
+
+  /**
+   * Start recording one capture's elementary stream
+   * @param {{serial: string, codec: string}} meta
+   * @returns {{id: number, write: (chunk: Buffer) => void, close: () => Promise<object>}}
+   */
+  function openRecord({ serial, codec }) {
+    const record = {
+      id: nextRecordId++,
+      serial,
+      codec,
+      startedAt: Date.now(),
+      endedAt: null,
+      length: 0,
+      extents: [], // [{offset, length}] in logical bytes; interleaved writers split records
+      keyframes: [], // [{offset, at}] logical offset of SPS/IDR start codes
+    };
+    let writeError = null;
+    let closed = false;
+
+    function write(chunk) {
+      if (closed) return; // stream data can trail the stop command
+      const at = Date.now();
+      const offset = allocate(chunk.length, at);
+
+      const last = record.extents[record.extents.length - 1];
+      if (last && last.offset + last.length === offset) {
+        last.length += chunk.length;
+      } else {
+        record.extents.push({ offset, length: chunk.length });
+      }
+      const keyframeAt = findKeyframeOffset(chunk, codec);
+      if (keyframeAt !== -1) {
+        record.keyframes.push({ offset: offset + keyframeAt, at });
+      }
+      record.length += chunk.length;
+
+      writeChain = writeChain
+        .then(() => writeAt(offset, chunk))
+        .catch((err) => {
+          writeError = err;
+        });
+    }
+
+    async function close() {
+      closed = true;
+      await writeChain;
+      record.endedAt = Date.now();
+      if (writeError) {
+        logger.error("Video ring write failed", { id: record.id, error: writeError.message });
+        return record;
+      }
+      // Skip a record the head already lapped (capture larger than the ring)
+      if (record.extents.every((e) => e.offset >= index.head - capacity) && record.length > 0) {
+        index.records.push(record);
+      }
+      saveIndex();
+      return record;
+    }
+
+    return { id: record.id, write, close };
+  }
+
+  /**
+   * Read a whole record back
+   * @param {number} id
+   * @returns {Promise<Buffer|null>} - null if the record was overwritten
+   */
+  async function readRecord(id) {
+    await writeChain;
+    const record = index.records.find((r) => r.id === id);
+    return record ? readExtents(fd, capacity, record) : null;
+  }
+
+  /**
+   * Records still in the ring, oldest first
+   * @param {string} [serial] - Only this camera
+   */
+  function records(serial) {
+    return index.records.filter((r) => !serial || r.serial === serial);
+  }
+
+  async function close() {
+    await writeChain;
+    fs.closeSync(fd);
+  }
+
+  return { openRecord, readRecord, records, close, capacity };
+}
@@ -7,10 +7,18 @@
  *   - package-detection-eval/no-package/     (expected: package_detected = false)
  *   - package-detection-eval/package-exists/ (expected: package_detected = true)
  *
- * Runs each image through the API in parallel (max 10/sec) and scores accuracy.
+ * Runs each image through the API in parallel (max 10/sec) and scores accuracy
+ * and per-image latency.
+ *
+ * With --local, the local classifier (LOCAL_MODEL) answers first and only
+ * uncertain images go to the API; results are broken down by which stage
+ * answered. --local-only never calls the API: uncertain images are scored on
+ * the classifier's best guess, once per image (it is deterministic).
  *
  * Usage:
  *   node package-detection-eval/run-eval.js
+ *   LOCAL_MODEL=models/doorstep.onnx node package-detection-eval/run-eval.js --local
+ *   LOCAL_MODEL=models/doorstep.onnx node package-detection-eval/run-eval.js --local-only
  */
 
 import "dotenv/config";
@@ -18,12 +26,16 @@ import fs from "fs";
 import path from "path";
 import { fileURLToPath } from "url";
 import { detectPackage } from "../lib/package-detector.js";
+import { summarize } from "../lib/metrics.js";
 
 const __filename = fileURLToPath(import.meta.url);
 const __dirname = path.dirname(__filename);
 
-const RUNS_PER_IMAGE = 3;
-const MAX_REQUESTS_PER_SECOND = 10;
+const localOnly = process.argv.includes("--local-only");
+const local = localOnly || process.argv.includes("--local");
+
+const RUNS_PER_IMAGE = localOnly ? 1 : 3;
+const MAX_REQUESTS_PER_SECOND = localOnly ? 1000 : 10;
 const NO_PACKAGE_DIR = path.join(__dirname, "no-package");
 const PACKAGE_EXISTS_DIR = path.join(__dirname, "package-exists");
 
@@ -64,14 +76,17 @@ async function runWithRateLimit(tasks, maxPerSecond) {
 async function evaluateSingle(imagePath, expected) {
   const fileName = path.basename(imagePath);
 
+  const startedAt = performance.now();
   try {
-    const result = await detectPackage(imagePath);
+    const result = await detectPackage(imagePath, { local, escalate: !localOnly });
     return {
       image: fileName,
       expected,
       detected: result.package_detected,
       confidence: result.confidence,
       description: result.description,
+      source: result.source,
+      latencyMs: Math.round(performance.now() - startedAt),
       error: null,
     };
   } catch (error) {
@@ -81,6 +96,8 @@ async function evaluateSingle(imagePath, expected) {
       detected: null,
       confidence: null,
       description: null,
+      source: null,
+      latencyMs: Math.round(performance.now() - startedAt),
       error: error.message,
     };
   }
@@ -93,6 +110,11 @@ function formatPercent(count, total) {
 }
 
 async function main() {
+  if (local && !process.env.LOCAL_MODEL) {
+    console.error("--local needs LOCAL_MODEL set to an ONNX model path");
+    process.exit(1);
+  }
+
   console.log("Package Detection Evaluation\n");
   console.log("=".repeat(60));
 
@@ -173,6 +195,29 @@ async function main() {
   const accuracy = totalValid > 0 ? (truePositive + trueNegative) / totalValid * 100 : 0;
   console.log(`\nOverall Accuracy: ${accuracy.toFixed(1)}%`);
 
+  console.log(`\n${"=".repeat(60)}`);
+  console.log("LATENCY (ms)");
+  console.log("=".repeat(60));
+  const bySource = { all: results };
+  if (local) {
+    bySource.local = results.filter((r) => r.source === "local");
+    bySource.llm = results.filter((r) => r.source === "llm");
+  }
+  console.log(`\n${"".padEnd(8)}${"count".padStart(8)}${"p50".padStart(8)}${"p95".padStart(8)}${"max".padStart(8)}${"accuracy".padStart(10)}`);
+  for (const [source, runs] of Object.entries(bySource)) {
+    const s = summarize(runs.map((r) => r.latencyMs));
+    const scored = runs.filter((r) => !r.error);
+    const correct = scored.filter((r) => r.expected === r.detected).length;
+    const accuracy = scored.length > 0 ? `${(correct / scored.length * 100).toFixed(1)}%` : "-";
+    console.log(
+      `${source.padEnd(8)}${String(s.count).padStart(8)}${String(s.p50 ?? "-").padStart(8)}` +
+      `${String(s.p95 ?? "-").padStart(8)}${String(s.max ?? "-").padStart(8)}${accuracy.padStart(10)}`
+    );
+  }
+  if (local) {
+    console.log(`\nAnswered locally: ${formatPercent(bySource.local.length, results.length)}`);
+  }
+
   if (failures.length > 0) {
     console.log(`\n${"=".repeat(60)}`);
     console.log("FAILURES");
@@ -183,6 +228,7 @@ async function main() {
       console.log(`  Expected: ${f.expected}`);
       console.log(`  Got: ${f.detected}`);
       if (f.confidence) console.log(`  Confidence: ${f.confidence}`);
+      if (f.source) console.log(`  Source: ${f.source}`);
       if (f.description) console.log(`  Description: ${f.description}`);
       if (f.error) console.log(`  Error: ${f.error}`);
     }
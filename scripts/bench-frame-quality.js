@@ -0,0 +1,61 @@
+#!/usr/bin/env node
+
+/**
+ * Benchmark best-frame scoring (FRAME_SELECTION=best) on the
+ * package-detection-eval images: the reduced-scale grayscale decode of the
+ * doorstep region, and the sharpness/exposure score on it.
+ *
+ * Usage:
+ *   node scripts/bench-frame-quality.js [max-images]   # default: all
+ */
+
+import fs from "fs";
+import path from "path";
+import { roiThumbnail } from "../lib/image-processor.js";
+import { QUALITY_WIDTH, scoreFrame } from "../lib/frame-quality.js";
+import { summarize } from "../lib/metrics.js";
+
+const EVAL_DIR = "./package-detection-eval";
+
+const maxImages = parseInt(process.argv[2] || "0");
+let images = ["no-package", "package-exists"]
+  .map((dir) => path.join(EVAL_DIR, dir))
+  .filter((dir) => fs.existsSync(dir))
+  .flatMap((dir) => fs.readdirSync(dir).filter((f) => /\.jpe?g$/i.test(f)).map((f) => path.join(dir, f)));
+if (maxImages > 0) images = images.slice(0, maxImages);
+if (images.length === 0) {
+  console.error(`No images found in ${EVAL_DIR}`);
+  process.exit(1);
+}
+
+// Frames arrive from ffmpeg in memory, so time from the JPEG bytes
+const jpegs = images.map((imagePath) => fs.readFileSync(imagePath));
+await roiThumbnail(jpegs[0], QUALITY_WIDTH); // warm up libvips
+
+const decodeMs = [];
+const scoreMs = [];
+const scored = [];
+for (const [i, jpeg] of jpegs.entries()) {
+  const t0 = performance.now();
+  const thumbnail = await roiThumbnail(jpeg, QUALITY_WIDTH);
+  const t1 = performance.now();
+  const quality = scoreFrame(thumbnail);
+  const t2 = performance.now();
+  decodeMs.push(Math.round((t1 - t0) * 100) / 100);
+  scoreMs.push(Math.round((t2 - t1) * 100) / 100);
+  scored.push({ image: path.basename(images[i]), ...quality });
+}
+
+console.log(`${images.length} images, ${QUALITY_WIDTH}px-wide region`);
+console.log(`${"ms per frame".padEnd(16)}${"p50".padStart(8)}${"p95".padStart(8)}${"max".padStart(8)}`);
+for (const [label, samples] of [["decode", decodeMs], ["score", scoreMs], ["total", decodeMs.map((d, i) => d + scoreMs[i])]]) {
+  const s = summarize(samples.map((ms) => Math.round(ms * 100) / 100));
+  console.log(`${label.padEnd(16)}${String(s.p50).padStart(8)}${String(s.p95).padStart(8)}${String(s.max).padStart(8)}`);
+}
+
+// The lowest scores are worth a look: blurred or badly exposed frames
+scored.sort((a, b) => a.score - b.score);
+console.log("\nLowest scores:");
+for (const s of scored.slice(0, 5)) {
+  console.log(`  ${s.image}  sharpness ${s.sharpness.toFixed(1)}  exposure ${s.exposure.toFixed(2)}`);
+}
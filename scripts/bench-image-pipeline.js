@@ -0,0 +1,122 @@
+#!/usr/bin/env node
+
+/**
+ * Benchmark per-frame image work on the package-detection-eval images:
+ * crop/scale for the API, base64 and the annotated image.
+ *
+ *   file:  cropAndScale() and addTextOverlay() on the path (two full decodes
+ *          plus two metadata reads per frame)
+ *   frame: loadFrame() once, then cropAndScaleFrame() and addTextOverlay()
+ *          on the decoded frame
+ *
+ * With --roi, only the API crop is timed:
+ *
+ *   full:   loadFrame() + cropAndScaleFrame()
+ *   scaled: cropAndScaleJpeg() (scaled-IDCT decode, no full-size image)
+ *
+ * With --publish, the image work a detection does before its result can be
+ * published (the LLM call itself excluded):
+ *
+ *   inline:   decode once, API crop, then the annotated image (before the
+ *             annotation queue)
+ *   deferred: API crop from the in-memory JPEG only; the annotated image is
+ *             rendered after publishing
+ *
+ * Usage:
+ *   node scripts/bench-image-pipeline.js [max-images]         # default: all
+ *   node scripts/bench-image-pipeline.js --roi [max-images]
+ *   node scripts/bench-image-pipeline.js --publish [max-images]
+ */
+
+import fs from "fs";
+import os from "os";
+import path from "path";
+import {
+  loadFrame,
+  cropAndScale,
+  cropAndScaleFrame,
+  cropAndScaleJpeg,
+  addTextOverlay,
+  cleanupTemp,
+} from "../lib/image-processor.js";
+import { summarize } from "../lib/metrics.js";
+
+const EVAL_DIR = "./package-detection-eval";
+const RESULT = { package_detected: true, confidence: "high", description: "Benchmark overlay text" };
+
+const roiOnly = process.argv.includes("--roi");
+const publishPath = process.argv.includes("--publish");
+const maxImages = parseInt(process.argv.slice(2).find((a) => !a.startsWith("--")) || "0");
+let images = ["no-package", "package-exists"]
+  .map((dir) => path.join(EVAL_DIR, dir))
+  .filter((dir) => fs.existsSync(dir))
+  .flatMap((dir) => fs.readdirSync(dir).filter((f) => /\.jpe?g$/i.test(f)).map((f) => path.join(dir, f)));
+if (maxImages > 0) images = images.slice(0, maxImages);
+if (images.length === 0) {
+  console.error(`No images found in ${EVAL_DIR}`);
+  process.exit(1);
+}
+
+const outDir = fs.mkdtempSync(path.join(os.tmpdir(), "bench-image-"));
+
+async function viaFile(imagePath, outPath) {
+  const croppedPath = await cropAndScale(imagePath);
+  fs.readFileSync(croppedPath).toString("base64");
+  cleanupTemp(croppedPath);
+  await addTextOverlay(imagePath, RESULT, outPath);
+}
+
+async function viaFrame(imagePath, outPath) {
+  const frame = await loadFrame(imagePath);
+  (await cropAndScaleFrame(frame)).toString("base64");
+  await addTextOverlay(frame, RESULT, outPath);
+}
+
+async function roiFull(imagePath) {
+  await cropAndScaleFrame(await loadFrame(imagePath));
+}
+
+async function roiScaled(imagePath) {
+  await cropAndScaleJpeg(imagePath);
+}
+
+async function publishInline(imagePath, outPath) {
+  const frame = await loadFrame(imagePath, fs.readFileSync(imagePath));
+  (await cropAndScaleFrame(frame)).toString("base64");
+  await addTextOverlay(frame, RESULT, outPath);
+}
+
+async function publishDeferred(imagePath) {
+  (await cropAndScaleJpeg(fs.readFileSync(imagePath))).toString("base64");
+}
+
+// Cropping writes next to the input; work on copies so the eval set is untouched
+const copies = images.map((imagePath, i) => {
+  const copy = path.join(outDir, `frame_${i}.jpg`);
+  fs.copyFileSync(imagePath, copy);
+  return copy;
+});
+
+const results = {};
+let modes = [["file", viaFile], ["frame", viaFrame]];
+if (roiOnly) modes = [["full", roiFull], ["scaled", roiScaled]];
+if (publishPath) modes = [["inline", publishInline], ["deferred", publishDeferred]];
+for (const [label, run] of modes) {
+  await run(copies[0], path.join(outDir, "warmup.jpg"));
+  const samples = [];
+  const startedAt = performance.now();
+  for (const [i, copy] of copies.entries()) {
+    const t0 = performance.now();
+    await run(copy, path.join(outDir, `${label}_${i}_annotated.jpg`));
+    samples.push(Math.round((performance.now() - t0) * 10) / 10);
+  }
+  results[label] = { ...summarize(samples), totalMs: Math.round(performance.now() - startedAt) };
+}
+
+console.log(`${images.length} images`);
+console.log(`${"ms per frame".padEnd(16)}${"p50".padStart(8)}${"p95".padStart(8)}${"max".padStart(8)}${"total".padStart(10)}`);
+for (const [label, r] of Object.entries(results)) {
+  console.log(`${label.padEnd(16)}${String(r.p50).padStart(8)}${String(r.p95).padStart(8)}${String(r.max).padStart(8)}${String(r.totalMs).padStart(10)}`);
+}
+
+fs.rmSync(outDir, { recursive: true, force: true });
@@ -0,0 +1,55 @@
+#!/usr/bin/env node
+
+/**
+ * Compare the per-cycle MQTT cost of connecting for every publish (what
+ * capture.js did before) against one long-lived publisher.
+ *
+ * Needs the broker running (npm run server). Publishes non-retained
+ * messages to bench/publish, so LED and Slack state are untouched.
+ *
+ * Usage:
+ *   node scripts/bench-mqtt-publish.js [cycles]   # default: 50
+ */
+
+import { createClient, createPublisher, disconnect } from "../lib/mqtt-client.js";
+import { summarize } from "../lib/metrics.js";
+
+const TOPIC = "bench/publish";
+const cycles = parseInt(process.argv[2] || "50");
+
+function message(i) {
+  return JSON.stringify({ exists: false, cycle: i, timestamp: new Date().toISOString() });
+}
+
+// Before: connect, publish, disconnect every cycle
+const perConnection = [];
+for (let i = 0; i < cycles; i++) {
+  const startedAt = performance.now();
+  const client = await createClient("bench");
+  await new Promise((resolve, reject) =>
+    client.publish(TOPIC, message(i), { qos: 1 }, (err) => (err ? reject(err) : resolve()))
+  );
+  await disconnect(client);
+  perConnection.push(performance.now() - startedAt);
+}
+
+// After: one publisher for every cycle
+const publisher = createPublisher("bench");
+await publisher.publish(TOPIC, message(-1), { qos: 1 }); // wait for the first connect
+const persistent = [];
+for (let i = 0; i < cycles; i++) {
+  const startedAt = performance.now();
+  await publisher.publish(TOPIC, message(i), { qos: 1 });
+  persistent.push(performance.now() - startedAt);
+}
+await publisher.close();
+
+function row(label, samples) {
+  const s = summarize(samples.map((ms) => Math.round(ms * 100) / 100));
+  return `${label.padEnd(24)}${String(s.count).padStart(8)}${String(s.p50).padStart(10)}${String(s.p95).padStart(10)}${String(s.max).padStart(10)}`;
+}
+
+console.log(`${"per cycle (ms)".padEnd(24)}${"count".padStart(8)}${"p50".padStart(10)}${"p95".padStart(10)}${"max".padStart(10)}`);
+console.log(row("connect per cycle", perConnection));
+console.log(row("persistent publisher", persistent));
+process.exit(0);
@@ -0,0 +1,117 @@
+#!/usr/bin/env node
+
+/**
+ * Tune the change gate (CHANGE_GATE_*) on the package-detection-eval images.
+ *
+ * For pairs of eval frames, treats the first as the last frame sent for
+ * detection and the second as a new capture, and reports per threshold
+ * setting:
+ *   - skipped: share of no-package -> no-package pairs the gate would
+ *     answer from the previous result (LLM calls saved on an idle doorstep)
+ *   - missed:  share of pairs where the package state differs that the
+ *     gate would still answer from the previous result, i.e. the false-skip
+ *     rate (must stay ~0)
+ *
+ * With --phash, the same for the perceptual-hash cache (CHANGE_GATE=phash)
+ * per PHASH_MAX_DISTANCE. The row for the thresholds capture.js would use
+ * (from the environment, else its defaults) is marked.
+ *
+ * Usage:
+ *   node scripts/eval-change-gate.js [pixel-delta]   # default: CHANGE_GATE_PIXEL_DELTA or 25
+ *   node scripts/eval-change-gate.js --phash
+ */
+
+import fs from "fs";
+import path from "path";
+import { roiSquare, roiThumbnail } from "../lib/image-processor.js";
+import { compareThumbnails, THUMBNAIL_WIDTH } from "../lib/change-gate.js";
+import { hammingDistance, perceptualHash } from "../lib/phash-cache.js";
+
+const EVAL_DIR = "./package-detection-eval";
+const MAX_PAIRS = 5000;
+const MEAN_DIFFS = [2, 4, 6, 8];
+const CHANGED_FRACTIONS = [0.002, 0.005, 0.01, 0.02, 0.05];
+const HAMMING_DISTANCES = [0, 2, 4, 6, 8, 10, 12];
+const PHASH_INPUT_SIZE = 32;
+
+// capture.js defaults
+const CURRENT_MAX_MEAN_DIFF = parseFloat(process.env.CHANGE_GATE_MAX_MEAN_DIFF || "4");
+const CURRENT_MAX_CHANGED_FRACTION = parseFloat(process.env.CHANGE_GATE_MAX_CHANGED_FRACTION || "0.01");
+const CURRENT_PHASH_MAX_DISTANCE = parseInt(process.env.PHASH_MAX_DISTANCE || "2");
+const CURRENT = "  <- current";
+
+const phash = process.argv.includes("--phash");
+const pixelDelta = parseInt(
+  process.argv.slice(2).find((a) => !a.startsWith("--")) || process.env.CHANGE_GATE_PIXEL_DELTA || "25"
+);
+
+async function fingerprint(imagePath) {
+  if (phash) return perceptualHash(await roiSquare(imagePath, PHASH_INPUT_SIZE));
+  return roiThumbnail(imagePath, THUMBNAIL_WIDTH);
+}
+
+function compare(a, b) {
+  if (phash) return hammingDistance(a, b);
+  return compareThumbnails(a, b, pixelDelta);
+}
+
+async function thumbnails(dir) {
+  const full = path.join(EVAL_DIR, dir);
+  if (!fs.existsSync(full)) return [];
+  const files = fs.readdirSync(full).filter((f) => /\.jpe?g$/i.test(f)).sort();
+  return Promise.all(files.map((f) => fingerprint(path.join(full, f))));
+}
+
+function pairs(from, to, sameSet) {
+  const out = [];
+  for (let i = 0; i < from.length; i++) {
+    for (let j = 0; j < to.length; j++) {
+      if (sameSet && i === j) continue;
+      out.push(compare(to[j], from[i]));
+    }
+  }
+  // Evenly spaced sample keeps run time bounded on large eval sets
+  const step = Math.max(1, Math.floor(out.length / MAX_PAIRS));
+  return out.filter((_, i) => i % step === 0);
+}
+
+const noPackage = await thumbnails("no-package");
+const packageExists = await thumbnails("package-exists");
+if (noPackage.length < 2 || packageExists.length === 0) {
+  console.error(`Need images in ${EVAL_DIR}/no-package and ${EVAL_DIR}/package-exists`);
+  process.exit(1);
+}
+
+const idle = pairs(noPackage, noPackage, true);
+const stateChanged = [...pairs(noPackage, packageExists, false), ...pairs(packageExists, noPackage, false)];
+
+function rate(samples, reused) {
+  return `${((samples.filter(reused).length / samples.length) * 100).toFixed(1).padStart(9)}%`;
+}
+
+if (phash) {
+  console.log(`pHash; ${idle.length} idle pairs, ${stateChanged.length} state-change pairs`);
+  console.log(`${"max distance".padStart(14)}${"skipped".padStart(10)}${"missed".padStart(10)}`);
+  const distances = [...new Set([...HAMMING_DISTANCES, CURRENT_PHASH_MAX_DISTANCE])].sort((a, b) => a - b);
+  for (const maxDistance of distances) {
+    const reused = (distance) => distance <= maxDistance;
+    const mark = maxDistance === CURRENT_PHASH_MAX_DISTANCE ? CURRENT : "";
+    console.log(`${String(maxDistance).padStart(14)}${rate(idle, reused)}${rate(stateChanged, reused)}${mark}`);
+  }
+  process.exit(0);
+}
+
+console.log(`pixel delta ${pixelDelta}; ${idle.length} idle pairs, ${stateChanged.length} state-change pairs`);
+console.log(`${"max mean diff".padStart(14)}${"max changed".padStart(13)}${"skipped".padStart(10)}${"missed".padStart(10)}`);
+const meanDiffs = [...new Set([...MEAN_DIFFS, CURRENT_MAX_MEAN_DIFF])].sort((a, b) => a - b);
+const changedFractions = [...new Set([...CHANGED_FRACTIONS, CURRENT_MAX_CHANGED_FRACTION])].sort((a, b) => a - b);
+for (const maxMeanDiff of meanDiffs) {
+  for (const maxChangedFraction of changedFractions) {
+    const reused = (c) => c.meanDiff <= maxMeanDiff && c.changedFraction <= maxChangedFraction;
+    const current = maxMeanDiff === CURRENT_MAX_MEAN_DIFF && maxChangedFraction === CURRENT_MAX_CHANGED_FRACTION;
+    console.log(
+      `${String(maxMeanDiff).padStart(14)}${String(maxChangedFraction).padStart(13)}` +
+      `${rate(idle, reused)}${rate(stateChanged, reused)}${current ? CURRENT : ""}`
+    );
+  }
+}
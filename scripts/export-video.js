@@ -0,0 +1,55 @@
+#!/usr/bin/env node
+
+/**
+ * Export raw video from the capture ring (captured/video-ring) to a file.
+ *
+ * Usage:
+ *   node scripts/export-video.js                   # List records still in the ring
+ *   node scripts/export-video.js <record-id> [out]  # Write one record to out (default: capture_<serial>_<ts>.<codec>)
+ *
+ * The ring is opened read-only with the size recorded in its index, so this
+ * is safe to run while the capture service is writing to it.
+ */
+
+import fs from "fs";
+import { openVideoRingReader } from "../lib/video-ring-store.js";
+
+const VIDEO_RING_DIR = "./captured/video-ring";
+
+if (!fs.existsSync(`${VIDEO_RING_DIR}/index.json`)) {
+  console.error(`No video ring found at ${VIDEO_RING_DIR}`);
+  process.exit(1);
+}
+
+let ring;
+try {
+  ring = openVideoRingReader(VIDEO_RING_DIR);
+} catch (error) {
+  console.error(`Could not open video ring: ${error.message}`);
+  process.exit(1);
+}
+const id = process.argv[2];
+
+if (!id) {
+  for (const r of ring.records()) {
+    const seconds = ((r.endedAt - r.startedAt) / 1000).toFixed(1);
+    console.log(
+      `${String(r.id).padStart(6)}  ${r.serial}  ${new Date(r.startedAt).toISOString()}  ` +
+      `${seconds}s  ${(r.length / 1024).toFixed(0)} KiB  ${r.keyframes.length} keyframes`
+    );
+  }
+  ring.close();
+  process.exit(0);
+}
+
+const record = ring.records().find((r) => r.id === parseInt(id));
+const data = record ? ring.readRecord(record.id) : null;
+if (!data) {
+  console.error(`Record ${id} is not in the ring (overwritten or never existed)`);
+  process.exit(1);
+}
+
+const outPath = process.argv[3] || `capture_${record.serial}_${record.startedAt}.${record.codec}`;
+fs.writeFileSync(outPath, data);
+console.log(`Wrote ${data.length} bytes to ${outPath}`);
+ring.close();
@@ -0,0 +1,208 @@
+#!/usr/bin/env node
+
+/**
+ * Replay historical detection logs through capture interval policies.
+ *
+ * The logged package_detection results are treated as ground truth (the
+ * doorstep state changes at the logged observation where it flipped), and
+ * capture_trigger lines as motion. Each policy is then simulated over the
+ * same period and scored on captures per day (livestream sessions and LLM
+ * calls) and on how long it took to notice each package_exists transition.
+ *
+ * Usage:
+ *   journalctl -u eufy-capture -o short-iso > capture.log
+ *   node scripts/simulate-schedule.js capture.log
+ *   node scripts/simulate-schedule.js capture.log --loop 180s --policy fixed,adaptive
+ *
+ * Timestamps are read from journalctl's short-iso prefix or from
+ * LOG_TIMESTAMPS=1 output.
+ */
+
+import fs from "fs";
+import { POLICIES, createPolicy } from "../lib/capture-policy.js";
+import { summarize } from "../lib/metrics.js";
+import { parseDuration } from "../lib/utils.js";
+
+const DAY_MS = 24 * 60 * 60 * 1000;
+const HISTORY_LENGTH = 50; // matches POLICY_HISTORY_LENGTH in capture.js
+const ISO_TIMESTAMP = /\d{4}-\d{2}-\d{2}T\d{2}:\d{2}:\d{2}(?:\.\d+)?(?:Z|[+-]\d{2}:?\d{2})?/;
+
+function argValue(name, fallback) {
+  const index = process.argv.indexOf(name);
+  return index !== -1 && process.argv[index + 1] ? process.argv[index + 1] : fallback;
+}
+
+/**
+ * Deterministic PRNG so policy jitter is reproducible between runs
+ */
+function seededRandom(seed) {
+  return () => {
+    seed = (seed + 0x6d2b79f5) | 0;
+    let t = Math.imul(seed ^ (seed >>> 15), 1 | seed);
+    t = (t + Math.imul(t ^ (t >>> 7), 61 | t)) ^ t;
+    return ((t ^ (t >>> 14)) >>> 0) / 4294967296;
+  };
+}
+
+/**
+ * Extract package_detection observations and motion triggers from a log
+ * @param {string} text
+ */
+function parseLog(text) {
+  const observations = [];
+  const motions = [];
+  const cameraState = new Map();
+
+  for (const rawLine of text.split("\n")) {
+    const line = rawLine.replace(/\x1b\[[0-9;]*m/g, "");
+    const isDetection = line.includes("[package_detection]");
+    const isTrigger = line.includes("[capture_trigger]");
+    if (!isDetection && !isTrigger) continue;
+
+    const ts = line.match(ISO_TIMESTAMP);
+    if (!ts) continue;
+    const at = Date.parse(ts[0].replace(/([+-]\d{2})(\d{2})$/, "$1:$2"));
+    if (Number.isNaN(at)) continue;
+
+    if (isTrigger) {
+      motions.push(at);
+      continue;
+    }
+
+    let meta;
+    try {
+      meta = JSON.parse(line.slice(line.indexOf("{")));
+    } catch {
+      continue;
+    }
+
+    // Doorstep state is "any camera sees a package", as on the server
+    cameraState.set(meta.camera || "", meta.detected === true);
+    observations.push({ at, detected: [...cameraState.values()].some(Boolean) });
+  }
+
+  observations.sort((a, b) => a.at - b.at);
+  motions.sort((a, b) => a - b);
+  return { observations, motions };
+}
+
+/**
+ * State of the doorstep at time t (last observation at or before t)
+ */
+function truthAt(observations, t) {
+  let lo = 0;
+  let hi = observations.length - 1;
+  while (lo < hi) {
+    const mid = (lo + hi + 1) >> 1;
+    if (observations[mid].at <= t) lo = mid;
+    else hi = mid - 1;
+  }
+  return observations[lo].detected;
+}
+
+function lastBefore(sortedTimes, t) {
+  let result = null;
+  for (const time of sortedTimes) {
+    if (time > t) break;
+    result = time;
+  }
+  return result;
+}
+
+function simulate(policy, { observations, motions }) {
+  const start = observations[0].at;
+  const end = observations[observations.length - 1].at;
+  const samples = [];
+  const history = [];
+  let lastTransitionAt = null;
+
+  let t = start;
+  while (t <= end) {
+    const detected = truthAt(observations, t);
+    const previous = samples[samples.length - 1];
+    if (previous && previous.detected !== detected) {
+      lastTransitionAt = t;
+    }
+    samples.push({ at: t, detected });
+    history.push({ at: t, detected });
+    if (history.length > HISTORY_LENGTH) history.shift();
+
+    const state = { history, lastMotionAt: lastBefore(motions, t), lastTransitionAt };
+    let next = t + policy.nextDelay({ now: t, ...state });
+
+    // The capture loop wakes on motion and lets the policy shorten the wait
+    for (const m of motions) {
+      if (m <= t) continue;
+      if (m >= next) break;
+      next = Math.min(next, m + policy.nextDelay({ now: m, ...state, lastMotionAt: m }));
+    }
+    t = next;
+  }
+
+  // Latency from each true transition to the first sample that saw it
+  const latencies = [];
+  let missed = 0;
+  for (let i = 1; i < observations.length; i++) {
+    if (observations[i].detected === observations[i - 1].detected) continue;
+    const transition = observations[i];
+    const nextChange = observations.slice(i + 1).find((o) => o.detected !== transition.detected);
+    const seen = samples.find(
+      (s) => s.at >= transition.at && (!nextChange || s.at < nextChange.at)
+    );
+    if (seen) latencies.push(seen.at - transition.at);
+    else missed++;
+  }
+
+  const days = Math.max((end - start) / DAY_MS, 1 / 24);
+  return {
+    captures: samples.length,
+    perDay: Math.round(samples.length / days),
+    latency: summarize(latencies),
+    missed,
+  };
+}
+
+function formatSeconds(ms) {
+  return ms === null ? "-" : `${Math.round(ms / 1000)}s`;
+}
+
+async function main() {
+  const logPath = process.argv[2];
+  if (!logPath || logPath.startsWith("--") || !fs.existsSync(logPath)) {
+    console.error("Usage: node scripts/simulate-schedule.js <capture.log> [--loop 180s] [--policy fixed,adaptive]");
+    process.exit(1);
+  }
+
+  const baseIntervalMs = parseDuration(argValue("--loop", "180s"));
+  if (!baseIntervalMs) {
+    console.error("Invalid --loop duration. Use format: 60s, 5m, 1h");
+    process.exit(1);
+  }
+  const policyNames = argValue("--policy", Object.keys(POLICIES).join(",")).split(",");
+
+  const log = parseLog(fs.readFileSync(logPath, "utf-8"));
+  if (log.observations.length < 2) {
+    console.error("Need at least two package_detection lines with timestamps in the log");
+    process.exit(1);
+  }
+
+  const spanHours = (log.observations[log.observations.length - 1].at - log.observations[0].at) / 3600000;
+  console.log(`Replaying ${log.observations.length} detections and ${log.motions.length} motion triggers over ${spanHours.toFixed(1)}h`);
+  console.log(`Base interval: ${baseIntervalMs / 1000}s\n`);
+  console.log("policy      captures  per-day  latency p50   p95   max  missed");
+
+  for (const name of policyNames) {
+    const policy = createPolicy(name, { baseIntervalMs, random: seededRandom(42) });
+    const r = simulate(policy, log);
+    console.log(
+      `${name.padEnd(10)}  ${String(r.captures).padStart(8)}  ${String(r.perDay).padStart(7)}  ` +
+      `${formatSeconds(r.latency.p50).padStart(11)}  ${formatSeconds(r.latency.p95).padStart(4)}  ` +
+      `${formatSeconds(r.latency.max).padStart(4)}  ${String(r.missed).padStart(6)}`
+    );
+  }
+}
+
+main().catch((err) => {
+  console.error("Fatal error:", err.message);
+  process.exit(1);
+});
@@ -5,6 +5,7 @@
  *
  * Usage:
  *   node test-capture-crop.js <input-image.jpg>
+ *   node test-capture-crop.js --bench [iterations] <input-image.jpg>
  *
  * This will:
  *   1. Crop the image starting at y=1400
@@ -12,13 +13,92 @@
  *   3. Save as <input>_cropped_scaled.jpg
  *   4. Add a test text overlay to the original
  *   5. Save as <input>_annotated.jpg
+ *
+ * With --bench, instead times rendering the overlay for the image's size:
+ * the single SVG rasterized by librsvg per call against the cached band and
+ * line sprites, with descriptions that repeat (all cache hits) and with a
+ * new description every call (a miss per line), then the full
+ * addTextOverlay() including the JPEG encode.
  */
 
-import { cropAndScale, addTextOverlay, cleanupTemp } from "../lib/image-processor.js";
+import sharp from "sharp";
+import { cropAndScale, addTextOverlay, cleanupTemp, loadFrame, DEFAULT_ROI } from "../lib/image-processor.js";
+import { overlaySvg, renderOverlay } from "../lib/overlay-renderer.js";
+import { summarize } from "../lib/metrics.js";
 import fs from "fs";
 import path from "path";
+import os from "os";
+
+const BENCH_RESULTS = [
+  {
+    package_detected: true,
+    confidence: "high",
+    description: "A brown cardboard box approximately 12x8x6 inches is visible on the doorstep near the welcome mat. The package appears to have an Amazon shipping label.",
+  },
+  {
+    package_detected: false,
+    confidence: "high",
+    description: "The doorstep is clear. No packages, boxes, or delivery items are visible.",
+  },
+  {
+    package_detected: false,
+    confidence: "medium",
+    description: "A person is standing at the door holding a small envelope; nothing has been left behind yet.",
+  },
+];
+
+async function time(label, iterations, fn) {
+  // Fills the caches with an index the loop never uses, so a call meant to
+  // miss (a new description per index) still misses
+  await fn(iterations);
+  const samples = [];
+  for (let i = 0; i < iterations; i++) {
+    const t0 = performance.now();
+    await fn(i);
+    samples.push(performance.now() - t0);
+  }
+  const { p50, p95 } = summarize(samples);
+  console.log(`  ${label.padEnd(28)} p50 ${p50.toFixed(2)}ms  p95 ${p95.toFixed(2)}ms`);
+  return p50;
+}
+
+async function bench(inputPath, iterations) {
+  const frame = await loadFrame(inputPath);
+  // The overlay covers the frame down to the top of the default doorstep band
+  const height = Math.round(frame.height * DEFAULT_ROI[0][1]);
+  const result = (i) => BENCH_RESULTS[i % BENCH_RESULTS.length];
+  const outputPath = path.join(os.tmpdir(), `overlay-bench-${process.pid}.jpg`);
+  console.log(`Overlay ${frame.width}x${height}, ${iterations} iterations\n`);
+
+  const svg = await time("SVG per call", iterations, (i) =>
+    sharp(Buffer.from(overlaySvg(frame.width, height, result(i)))).raw().toBuffer(),
+  );
+  const repeated = await time("Cached sprites", iterations, (i) => renderOverlay(frame.width, height, result(i)));
+  const fresh = await time("Cached, new descriptions", iterations, (i) => {
+    const { description, ...rest } = result(i);
+    return renderOverlay(frame.width, height, { ...rest, description: `${description} (${i})` });
+  });
+  await time("addTextOverlay() + encode", iterations, (i) => addTextOverlay(frame, result(i), outputPath));
+  cleanupTemp(outputPath);
+
+  // Every fresh LLM result brings a new description, so that is the
+  // production case; repeated results only come from reused detections
+  console.log(`\nOverlay rendering ${(svg / fresh).toFixed(1)}x faster with the cached sprites for a new description`);
+  console.log(`(${(svg / repeated).toFixed(1)}x for a repeated result)`);
+}
 
 async function main() {
+  if (process.argv[2] === "--bench") {
+    const iterations = /^\d+$/.test(process.argv[3] || "") ? parseInt(process.argv[3]) : 50;
+    const benchPath = process.argv[/^\d+$/.test(process.argv[3] || "") ? 4 : 3];
+    if (!benchPath || !fs.existsSync(benchPath)) {
+      console.error("Usage: node test-capture-crop.js --bench [iterations] <input-image.jpg>");
+      process.exit(1);
+    }
+    await bench(benchPath, iterations);
+    return;
+  }
+
   const inputPath = process.argv[2];
 
   if (!inputPath) {
@@ -0,0 +1,70 @@
+#!/usr/bin/env node
+
+/**
+ * Summarize capture-to-LED traces written by capture.js and the server.
+ *
+ * Usage:
+ *   node scripts/trace-summary.js [data-dir]   # default: ./data
+ *
+ * Prints p50/p95/p99 per phase, and per trace the time from the start of
+ * the capture cycle until the last led_flashing fan-out finished.
+ */
+
+import fs from "fs";
+import path from "path";
+import { summarize } from "../lib/metrics.js";
+
+const dataDir = process.argv[2] || "./data";
+
+const files = fs.existsSync(dataDir)
+  ? fs.readdirSync(dataDir).filter((f) => /^traces-.+\.jsonl(\.1)?$/.test(f))
+  : [];
+if (files.length === 0) {
+  console.error(`No trace files found in ${dataDir}`);
+  process.exit(1);
+}
+
+const spans = [];
+for (const file of files) {
+  for (const line of fs.readFileSync(path.join(dataDir, file), "utf-8").split("\n")) {
+    if (!line.trim()) continue;
+    try {
+      spans.push(JSON.parse(line));
+    } catch {
+      // Partial line from a crash mid-write
+    }
+  }
+}
+
+const byPhase = new Map(); // "service/name" -> [durationMs]
+const byTrace = new Map(); // traceId -> {start, ledEnd}
+for (const span of spans) {
+  const phase = `${span.service}/${span.name}`;
+  if (!byPhase.has(phase)) byPhase.set(phase, []);
+  byPhase.get(phase).push(span.durationMs);
+
+  const trace = byTrace.get(span.traceId) || { start: null, ledEnd: null };
+  if (span.name === "capture_cycle") trace.start = span.startMs;
+  if (span.name === "led_fanout") {
+    trace.ledEnd = Math.max(trace.ledEnd || 0, span.startMs + span.durationMs);
+  }
+  byTrace.set(span.traceId, trace);
+}
+
+function row(label, summary) {
+  const cell = (v) => String(v ?? "-").padStart(8);
+  return `${label.padEnd(32)}${cell(summary.count)}${cell(summary.p50)}${cell(summary.p95)}${cell(summary.p99)}${cell(summary.max)}`;
+}
+
+console.log(`${"phase (ms)".padEnd(32)}${"count".padStart(8)}${"p50".padStart(8)}${"p95".padStart(8)}${"p99".padStart(8)}${"max".padStart(8)}`);
+for (const [phase, durations] of [...byPhase].sort(([a], [b]) => a.localeCompare(b))) {
+  console.log(row(phase, summarize(durations)));
+}
+
+const endToEnd = [...byTrace.values()]
+  .filter((t) => t.start !== null && t.ledEnd !== null)
+  .map((t) => t.ledEnd - t.start);
+if (endToEnd.length > 0) {
+  console.log();
+  console.log(row("capture cycle -> led_flashing", summarize(endToEnd)));
+}
@@ -6,15 +6,17 @@ import path from "path";
 import { fileURLToPath } from "url";
 import { logger } from "../lib/logger.js";
 import {
-  TOPIC_PACKAGE_EXISTS,
   TOPIC_USER_HANDLED,
   TOPIC_LED_FLASHING,
+  cameraKeyFromTopic,
 } from "../lib/mqtt-client.js";
 import {
   notifyPackageDetected,
   notifyPackagePickedUp,
   notifyPackageAcknowledged,
 } from "../lib/slack-notifier.js";
+import { createTracer, noopTrace } from "../lib/tracing.js";
+import { parseDuration } from "../lib/utils.js";
 
 const __filename = fileURLToPath(import.meta.url);
 const __dirname = path.dirname(__filename);
@@ -25,15 +27,25 @@ const MQTT_PASSWORD = process.env.MQTT_PASSWORD || "pass";
 const HTTP_PORT = 3000;
 const DATA_DIR = path.join(__dirname, "..", "data");
 const COOLDOWN_STATE_FILE = path.join(DATA_DIR, "cooldown-state.json");
-const IMAGE_STATE_FILE = path.join(DATA_DIR, "image-state.json");
-const HEALTHCHECK_WINDOW_MS = 10 * 60 * 1000; // 10 minutes
+// capture.js keeps its heartbeat inside the same window (same variable, same .env)
+const HEALTHCHECK_WINDOW_MS = parseDuration(process.env.HEALTHCHECK_WINDOW || "10m");
 const COOLDOWN_DURATION_MS = 2 * 60 * 1000; // 2 minutes
+const ANNOTATED_IMAGE_WAIT_MS = 5000; // capture.js renders it after publishing
+
+// Continues capture.js traces carried in package_exists payloads
+const tracer = createTracer("server", { dataDir: DATA_DIR });
+
+if (!HEALTHCHECK_WINDOW_MS) {
+  logger.error("Invalid HEALTHCHECK_WINDOW. Use format: 60s, 5m, 1h");
+  process.exit(1);
+}
 
 // ============================================
 // LED State Management
 // ============================================
 
-let packageExists = false;
+let packageExists = false; // true if any camera currently sees a package
+const cameraPackageState = new Map(); // cameraKey ("" = legacy topic) -> boolean
 let cooldownTimer = null;
 let lastPackageExistsAt = null; // timestamp of last package_exists message
 const serverStartedAt = Date.now();
@@ -54,16 +66,26 @@ function ensureDataDir() {
   }
 }
 
+/**
+ * Image state file for a camera (capture.js writes one per camera)
+ * @param {string} cameraKey - "" for the legacy single-camera file
+ */
+function imageStateFile(cameraKey) {
+  return path.join(DATA_DIR, cameraKey ? `image-state-${cameraKey}.json` : "image-state.json");
+}
+
 /**
  * Read the image state file written by capture.js
+ * @param {string} cameraKey - Camera the state belongs to
  * @returns {object|null} Image state or null if not found/invalid
  */
-function readImageState() {
+function readImageState(cameraKey) {
   try {
-    if (!fs.existsSync(IMAGE_STATE_FILE)) {
+    const statePath = imageStateFile(cameraKey);
+    if (!fs.existsSync(statePath)) {
       return null;
     }
-    const content = fs.readFileSync(IMAGE_STATE_FILE, "utf-8");
+    const content = fs.readFileSync(statePath, "utf-8");
     return JSON.parse(content);
   } catch (error) {
     logger.warn("Failed to read image state", { error: error.message });
@@ -71,6 +93,28 @@ function readImageState() {
   }
 }
 
+/**
+ * Image to attach to the Slack notification: the annotated image once
+ * capture.js has rendered it, or the plain frame if it does not appear in
+ * time
+ * @param {object} imageState - From readImageState()
+ * @returns {Promise<string>}
+ */
+async function notificationImage(imageState) {
+  if (!imageState.annotatedPath) return imageState.imagePath;
+  const deadline = Date.now() + ANNOTATED_IMAGE_WAIT_MS;
+  while (!fs.existsSync(imageState.annotatedPath)) {
+    if (Date.now() >= deadline) {
+      logger.warn("Annotated image not ready; sending the plain frame", {
+        annotatedPath: imageState.annotatedPath,
+      });
+      return imageState.imagePath;
+    }
+    await new Promise((resolve) => setTimeout(resolve, 100));
+  }
+  return imageState.annotatedPath;
+}
+
 function formatPSTTimestamp() {
   return new Date().toLocaleString("en-US", {
     timeZone: "America/Los_Angeles",
@@ -94,21 +138,31 @@ function writeCooldownState(cooldownActive) {
   logger.info("Cooldown state written", { inCooldown: cooldownActive });
 }
 
-function publishLedFlashing(flashing) {
+function publishLedFlashing(flashing, trace = noopTrace) {
   const payload = JSON.stringify({ flashing });
-  aedes.publish({
-    topic: TOPIC_LED_FLASHING,
-    payload: Buffer.from(payload),
-    qos: 1,
-    retain: true,
-  });
+  const fanoutStartedAt = Date.now();
+  aedes.publish(
+    {
+      topic: TOPIC_LED_FLASHING,
+      payload: Buffer.from(payload),
+      qos: 1,
+      retain: true,
+    },
+    () => {
+      // Called once the message has been handed to every subscriber
+      trace.record("led_fanout", fanoutStartedAt, Date.now(), {
+        flashing,
+        espClients: espClients.size,
+      });
+    }
+  );
   logger.info("Published led_flashing", { flashing });
 }
 
-function updateLedState() {
+function updateLedState(trace = noopTrace) {
   // LED should flash when package exists AND not in cooldown
   const shouldFlash = packageExists && !inCooldown();
-  publishLedFlashing(shouldFlash);
+  publishLedFlashing(shouldFlash, trace);
 }
 
 function startCooldown() {
@@ -198,38 +252,69 @@ aedes.on("publish", (packet, client) => {
     try {
       const payload = JSON.parse(packet.payload.toString());
 
-      if (packet.topic === TOPIC_PACKAGE_EXISTS) {
+      const cameraKey = cameraKeyFromTopic(packet.topic);
+
+      if (cameraKey !== null) {
         lastPackageExistsAt = Date.now();
-        const newPackageExists = payload.exists === true;
-        const stateChanged = newPackageExists !== packageExists;
-        const previousPackageExists = packageExists;
-        packageExists = newPackageExists;
+        const trace = payload.trace
+          ? tracer.startTrace(
+              "broker_handling",
+              {
+                camera: cameraKey || undefined,
+                sincePublishMs: payload.timestamp ? Date.now() - Date.parse(payload.timestamp) : undefined,
+              },
+              payload.trace
+            )
+          : noopTrace;
+        const cameraExists = payload.exists === true;
+        const previousCameraExists = cameraPackageState.get(cameraKey) === true;
+        cameraPackageState.set(cameraKey, cameraExists);
 
-        if (stateChanged) {
-          logger.info("Package state changed", { packageExists });
-          if (packageExists && !previousPackageExists) {
+        const previousPackageExists = packageExists;
+        packageExists = [...cameraPackageState.values()].some(Boolean);
+
+        if (cameraExists !== previousCameraExists) {
+          logger.info("Package state changed", {
+            camera: cameraKey || undefined,
+            cameraExists,
+            packageExists,
+          });
+          if (cameraExists) {
             // Package just appeared - send Slack notification with image
-            const imageState = readImageState();
+            const imageState = readImageState(cameraKey);
             if (imageState && imageState.imagePath) {
               logger.info("Sending Slack notification for package detected");
-              notifyPackageDetected(imageState.imagePath, {
-                package_detected: true,
-                description: imageState.description || "Package detected on doorstep",
-              });
+              notificationImage(imageState)
+                .catch((error) => {
+                  logger.warn("Could not wait for the annotated image; sending the plain frame", {
+                    error: error.message,
+                  });
+                  return imageState.imagePath;
+                })
+                .then((imagePath) =>
+                  notifyPackageDetected(imagePath, {
+                    package_detected: true,
+                    description: imageState.description || "Package detected on doorstep",
+                  })
+                );
             } else {
               logger.warn("No image state available for Slack notification");
             }
-          } else if (!packageExists && previousPackageExists) {
+          } else {
             // Package just disappeared - send pickup notification
-            logger.info("Package removed - clearing cooldown and notifying");
-            clearCooldown();
+            logger.info("Package removed - notifying");
             notifyPackagePickedUp();
+            if (!packageExists && previousPackageExists) {
+              logger.info("No packages left on any camera - clearing cooldown");
+              clearCooldown();
+            }
           }
         }
 
         // Always update LED state - handles case where cooldown ended
         // and capture.js confirms package still exists
-        updateLedState();
+        updateLedState(trace);
+        trace.end({ packageExists });
       } else if (packet.topic === TOPIC_USER_HANDLED && payload.handled === true) {
         if (packageExists) {
           logger.info("User handled package - starting cooldown and notifying");